@@ -13,6 +13,21 @@
 #include "/c/cs323/Hwk4/code.h"
 #include "./lzwHashTable.h"
 #include "./fcode.h"
+#include "./lzwHuffman.h"
+#include "./lzwArchive.h"
+#include "./lzwDaemon.h"
+#include "./lzwTrie.h"
+#include "./lzwFilter.h"
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdint.h>
+#include <sys/wait.h>
 #include <errno.h>
 
 //Element in table representing code-string pair
@@ -31,30 +46,452 @@ struct table{
     struct elt **table;//array/hashtable that stores the elements
 };
 
+//Sums of the string of a code kept by decode --test, which combine as
+//hash(xy) = hash(x) * power(y) + hash(y)
+struct sum{
+    uint64_t hash;//polynomial hash of the string in SUM_BASE
+    uint64_t power;//SUM_BASE to the length of the string
+    long length;//length of the string, 0 until testSum works it out
+};
+
+//Element kept by pruneTable, ordered by usage count under OPT_HOT
+struct survivor{
+    int usage;//usage count when pruned
+    int code;//code before pruning
+};
+
+//State of incremental eviction once the table is full
+struct evict{
+    int *children;//number of elements having each code as their prefix
+    int hand;//next code looked at when choosing an element to evict
+};
+
+//Code reached from another by the next JUMP_BYTES bytes of input
+struct jump{
+    uint64_t bytes;//the bytes, as loaded from the input
+    int from;//code the bytes extend, 0 if the slot is empty
+    int to;//code of the string of from followed by the bytes
+};
+
+//State of encode for one stream
+struct encoder{
+    Table t;//hashtable
+    Table tarr;//array table
+    long numBits;//current number of bits printed
+    int C;//code of the string matched so far
+    int curr;//current index for arrayTable
+    struct evict *ev;//eviction state if evicting
+    Trie frozen;//trie of the table once it can no longer change
+    int low;//first byte of a wide symbol, waiting for its second
+    Filter filter;//filters the input goes through, 0 if none
+    uint64_t *cache;//recent (prefix,K) -> code lookups, see cacheGet
+    struct jump *jumps;//JUMP_BYTES-byte extensions of codes, see jumpGet
+    int anchor;//code the bytes in path extend, EMPTY until the string
+               //matched so far is JUMP_BYTES bytes past its first
+    int steps;//number of bytes in path, or matched while anchor is EMPTY
+    unsigned char path[8];//bytes matched one at a time since anchor, up
+                          //to JUMP_BYTES
+    int plain;//calls of encoderRun left to make without jumps
+};
+
+//State of encode or decode at a sync-flush, saved by -k and restored by -r
+struct checkpoint{
+    int role;//'E' for encode, 'D' for decode
+    long maxBits;//max number of bits allowed
+    long prune;//minimum usage count upon pruning
+    long options;//stream options
+    long numBits;//current number of bits
+    int curr;//current index for arrayTable
+    int hand;//next code looked at by evictCode (OPT_EVICT)
+    int low;//first byte of a wide symbol not yet coded (EMPTY if none)
+    long inBytes;//bytes of input used (the stream, for decode)
+    long outBytes;//bytes of output written (the stream, for encode)
+};
+
 #define EMPTY (-1)
 #define INITIAL_BITS (9)
 #define MAX_MAX_BITS (24)
 #define BIT_FLAG (1)
 #define PRUNE_FLAG (0)
+#define FLUSH_FLAG (1)
+#define ODD_FLAG (0)
+#define SYNC (-2)
 #define ASCII_TOTAL (256)
 #define AFTER_ASCII (258)
+#define WIDE_TOTAL (65536)
+#define AFTER_WIDE (65538)
+#define STREAM_VERSION (2)
+#define OPT_ENTROPY (1)
+#define OPT_EVICT (2)
+#define OPT_WIDE (4)
+#define OPT_FILTER_SHIFT (3)//the options above OPT_WIDE are FILTER_ flags
+#define OPT_FILTERS (FILTER_ALL << OPT_FILTER_SHIFT)
+#define OPT_HOT (128)
+#define OPT_ALL (OPT_ENTROPY | OPT_EVICT | OPT_WIDE | OPT_FILTERS | OPT_HOT)
+#define EVICT_SCAN (32)
+#define AUTO_SIZE (1)
+#define AUTO_SPEED (2)
+#define AUTO_SAMPLE (1 << 20)
+#define BULK_CODES (4096)//codes unpacked at a time by bulkGet
+#define BULK_BYTES (16384)//bytes of input read ahead by bulkGet
+#define SUM_BASE (UINT64_C(0x100000001B3))//base of the hash of decode --test
+#define CACHE_BITS (11)//log2 of the slots of the encoder's pair cache
+#define JUMP_BITS (12)//log2 of the slots of the encoder's jumps
+#define JUMP_BYTES (8)//bytes a jump covers, compared as one word
+#define JUMP_SHARE (8)//jumps pay if they skip 1/JUMP_SHARE of the input
+#define JUMP_BACKOFF (16)//buffers encoded without jumps when they do not
+#define CHECKPOINT_VERSION (1)
+
+//maxBits and prune values tried by -m auto
+static const long autoBits[] = {10,12,14,16,18,20};
+static const long autoPrunes[] = {0,1,2};
+
+//first code after the literals: AFTER_ASCII, or AFTER_WIDE when the
+//symbols of the stream are 16 bits wide (OPT_WIDE)
+static int afterLiterals = AFTER_ASCII;
+
+/*
+ * Sets afterLiterals for a stream with these options.
+ */
+void symbolsSet(long options);
+
+/*
+ * Writes the symbol c to output: a byte, or two bytes (low byte first)
+ * for wide symbols.
+ */
+void symbolWrite(FILE *output, int c);
+
+/*
+ * Reads a symbol as written by symbolWrite; returns EOF if there is none.
+ */
+int symbolRead(FILE *input);
 
 /*
  * Function prunes the table and the table array.
  * It takes in the max number of bits allowed,
  * the minimum usage count allowed when pruning,
- * pointers to the table as a hashtable and as an array, and the initial size.
+ * pointers to the table as a hashtable and as an array, the initial size,
+ * and whether to number the elements kept hottest first (OPT_HOT) rather
+ * than in their old order.
  * It returns the number of bits needed at the end of the pruning.
  */
-int pruneTable(long maxBits, long prune, Table *tarr, Table *t, int initSize);
+int pruneTable(long maxBits, long prune, Table *tarr, Table *t, int initSize,
+				int hot);
+
+/*
+ * Orders survivors by usage count, highest first, then by old code.
+ * As an element is used whenever one of its children is, this keeps
+ * every prefix ahead of its children.
+ */
+int survivorCompare(const void *a, const void *b);
+
+/*
+ * Creates the hashtable and array table for maxBits, holding the ASCII
+ * values and then the elements of the table in the file named in
+ * (if not 0), as written by -o. Exits if that file cannot be read.
+ * Tables built ahead by tablesPreload for the same file (found by its
+ * full path) are lent instead of reading it again.
+ */
+void tablesCreate(long maxBits, char *in, Table *t, Table *tarr);
+
+/*
+ * Frees the tables made by tablesCreate, or gives lent tables back
+ * as they were lent: without the elements added since, and with the
+ * elements evicted and the usage counts of the array table changed since
+ * put back (those of the hashtable are never read).
+ */
+void tablesDestroy(Table t, Table tarr);
+
+/*
+ * Builds the tables tablesCreate gives out for maxBits and in, so that
+ * the workers of lzwd do not read the in-table on every request.
+ * Returns 0 (building nothing) if the in-table cannot be read or does not
+ * fit in maxBits.
+ */
+int tablesPreload(long maxBits, char *in);
+
+/*
+ * Clears what encode and decode leave behind in the bit I/O and the
+ * counts kept here, so that lzwd can serve another request in the same
+ * process. Reads standard input to its end.
+ */
+void codecReset(void);
+
+/*
+ * Returns the number of bits needed to write any code of a table
+ * holding n elements (never fewer than INITIAL_BITS).
+ * Version 2 streams derive the code width from this on both sides
+ * instead of sending BIT_FLAG.
+ */
+int codeWidth(int n);
+
+/*
+ * Creates the eviction state for the tables, counting the children
+ * of every element already in the array table.
+ */
+struct evict *evictCreate(long maxBits, Table tarr);
+
+/*
+ * Frees the eviction state.
+ */
+void evictDestroy(struct evict *ev);
+
+/*
+ * Chooses the code to reuse for a new element once the table is full,
+ * looking at no more than EVICT_SCAN codes from where the last call ended.
+ * Leaves (elements that are nobody's prefix) other than keep whose usage
+ * count has decayed to 0 are taken first; usage counts of the other leaves
+ * passed are halved. Returns EMPTY if no leaf was seen.
+ */
+int evictCode(struct evict *ev, Table tarr, long maxBits, int keep);
+
+/*
+ * Replaces the element with code victim by the element with the given
+ * prefix and final character in both the hashtable and the array table.
+ * Does nothing if victim is EMPTY.
+ */
+void evictInsert(struct evict *ev, Table *t, Table tarr,
+					int victim, int prefix, int c, long maxBits);
+
+/*
+ * Prints the array table (without the ASCII values) to output in the
+ * format read back by -i, renumbering elements so that every prefix
+ * comes before the elements using it.
+ */
+void writeTable(FILE *output, Table tarr);
+
+/*
+ * Writes code C to the stream, either with numBits bits
+ * or through the Huffman stage if options has OPT_ENTROPY.
+ */
+void writeCode(long options, long numBits, int C);
+
+/*
+ * Reads the next code from the stream as written by writeCode.
+ * Returns EOF at the end of the stream.
+ */
+int readCode(long options, long numBits);
+
+/*
+ * Makes readCode unpack codes a block at a time from standard input when
+ * that is a regular file, where reading ahead cannot hold back the output
+ * of a sync-flush still to arrive. Called by decode at a byte boundary,
+ * before it reads any codes.
+ */
+void bulkStart(long options);
+
+/*
+ * Returns the next code (numBits bits) as getBits does, from the codes
+ * unpacked by bulkFill.
+ */
+int bulkGet(int numBits);
+
+/*
+ * Unpacks as many of the next codes (numBits bits each) as are in the
+ * input read ahead, reading more first. Returns how many were unpacked.
+ */
+int bulkFill(int numBits);
+
+/*
+ * Unpacks the n codes of nBits bits starting at bit of in into codes,
+ * loading 64 bits for each so that there is no loop over bytes.
+ * in must have 8 bytes after the last code that are safe to read.
+ */
+void bulkUnpack(unsigned char *in, long bit, int nBits, int *codes, int n);
+
+/*
+ * Asks encode to sync-flush before it reads more input.
+ * Safe to call from a signal handler; encode calls it on SIGUSR1.
+ */
+void syncRequest(int sig);
+
+/*
+ * Points data at the next bytes of standard input for encode (at most max)
+ * and returns how many there are, EOF at the end, or SYNC if a sync-flush
+ * was requested or no input arrived within idle milliseconds (never, if
+ * idle is 0).
+ */
+long readInput(long idle, long max, unsigned char **data);
+
+/*
+ * Chooses maxBits and prune for -m auto by encoding up to AUTO_SAMPLE
+ * bytes of standard input with each combination of autoBits and autoPrunes,
+ * running up to jobs trials at once. prune is only tried if it was not
+ * given and -l is not used. With tune AUTO_SIZE the smallest output wins;
+ * with AUTO_SPEED the smallest product of output size and CPU time, the
+ * smaller output breaking ties. Each trial times itself with the CPU
+ * clock of its process, to the nanosecond, as a sample may take less
+ * than the tick getrusage counts in.
+ * The sample is handed to encode before the rest of standard input.
+ */
+void autoTune(long *maxBits, long *prune, char *in, long options,
+				long jobs, int tune);
+
+/*
+ * Sync-flushes the stream in encode: C, the code of the string matched
+ * so far, is written after FLUSH_FLAG, the stream is padded to a whole
+ * byte and everything is pushed to standard output, so that decode can
+ * print all input read so far. The table is kept, and the caller starts
+ * matching afresh (see encoderReset).
+ */
+void syncFlush(long options, long numBits, int C);
+
+/*
+ * Skips the padding after a sync-flush in decode.
+ */
+void syncAlign(long options);
+
+/*
+ * Compiles the array table into a trie once it is full and no longer
+ * changes, for encode to match with instead of the hashtable.
+ * Tables lent full by tablesCreate come with their trie built ahead.
+ */
+Trie trieFreeze(Table tarr);
+
+/*
+ * Frees a trie made by trieFreeze for tarr, unless it was built ahead.
+ */
+void trieThaw(Trie frozen, Table tarr);
+
+/*
+ * Writes the header of a stream, giving decode the stream version,
+ * maxBits, prune, the options and the in-table.
+ * Returns the number of bytes written.
+ */
+long encodeHeader(long maxBits, char *in, long prune, long options);
+
+/*
+ * Writes the checkpoint k and the elements of tarr after the literals
+ * (prefix, symbol and usage count) to the file named name, replacing it
+ * only once it is complete.
+ */
+void checkpointWrite(char *name, struct checkpoint *k, Table tarr,
+						Filter filter);
+
+/*
+ * Reads the checkpoint written by checkpointWrite for role ('E' or 'D')
+ * into k and rebuilds the tables and filters it was written from. Exits
+ * if the file cannot be read or is corrupt.
+ */
+void checkpointRead(char *name, int role, struct checkpoint *k,
+					Table *t, Table *tarr, Filter *filter);
+
+/*
+ * Returns the filters of the OPT_FILTERS in options, 0 if there are none.
+ */
+Filter filtersCreate(long options);
+
+/*
+ * Saves the state of encode just after a sync-flush to the file named name.
+ * k holds maxBits, prune and options; inBytes is the number of bytes of
+ * input used and outBase the number of bytes of the stream written before
+ * the codes counted by bitsWritten (or the Huffman stage).
+ */
+void encodeCheckpoint(char *name, struct encoder *s, struct checkpoint *k,
+						long inBytes, long outBase);
+
+/*
+ * Sets up the state of encode for a stream: its tables (see tablesCreate),
+ * code width and eviction state.
+ */
+void encoderCreate(struct encoder *s, long maxBits, char *in, long prune,
+					long options);
+
+/*
+ * Sets up the state of encode for the tables already in s, as encoderCreate.
+ */
+void encoderSetup(struct encoder *s, long maxBits, long prune, long options);
+
+/*
+ * Frees the state of encode for a stream.
+ */
+void encoderDestroy(struct encoder *s);
+
+/*
+ * Forgets the string matched so far, as after a sync-flush: the next
+ * byte starts a string, and no jump is taken until it has.
+ */
+void encoderReset(struct encoder *s);
+
+/*
+ * Writes the code of the string matched at the end of the input
+ * and any bits still held back. A wide stream of odd length first
+ * writes ODD_FLAG and its last byte.
+ */
+void encoderFinish(struct encoder *s, long options);
+
+/*
+ * Encodes the character K: extends the string matched so far, or writes
+ * its code and adds it followed by K to the table, pruning, evicting
+ * or freezing the table as needed. Wide streams pair each byte with the
+ * next into a symbol, low byte first.
+ * Returns 0 if a code was written and K starts the next string, 1 if not.
+ */
+int encoderStep(struct encoder *s, int K, long maxBits, long prune,
+					long options);
+
+/*
+ * Encodes the n bytes of data with encoderStep, skipping JUMP_BYTES bytes
+ * at a time where they repeat a jump from the string matched so far.
+ * Jumps are recorded and tried only once a string has matched JUMP_BYTES
+ * bytes past its first, and a buffer in which they skip too little of
+ * the input is followed by JUMP_BACKOFF buffers stepped a byte at a time,
+ * so that ordinary text pays next to nothing for them.
+ */
+void encoderRun(struct encoder *s, unsigned char *data, long n,
+				long maxBits, long prune, long options);
+
+/*
+ * Returns the code of the string matched so far followed by the
+ * JUMP_BYTES bytes at data if a jump records it, EMPTY otherwise.
+ * Every code a jump passes through is in the table, since the table
+ * holds every prefix of its strings, so the jump ends at the code
+ * encoderStep would reach a byte at a time and the codes written are
+ * the same. A jump whose codes eviction has since given to other strings
+ * is found out by following the prefixes of its code back to the anchor.
+ */
+int jumpGet(struct encoder *s, unsigned char *data);
+
+/*
+ * Returns the code of prefix followed by K if the pair cache holds it,
+ * EMPTY otherwise. Each slot packs a pair found by TableGet with its code,
+ * so most lookups of a stream cost one load from a 16K array that stays
+ * in the L1 cache instead of a hash and a walk of scattered elements.
+ */
+int cacheGet(uint64_t *cache, int prefix, int K);
+
+/*
+ * Puts prefix followed by K, with code, in its slot of the pair cache.
+ */
+void cachePut(uint64_t *cache, int prefix, int K, int code);
+
+/*
+ * Drops prefix followed by K from the pair cache, if it is there, as its
+ * code is about to be given to another string.
+ */
+void cacheForget(uint64_t *cache, int prefix, int K);
+
+/*
+ * Prints to stderr how many lookups of encode the pair cache answered
+ * and how many bytes jumps skipped.
+ */
+void cacheReport(void);
 
 /*
  * This function encodes the input stream.
  * It takes in the max number of bits allowed,
  * strings for the file to print a table to and get a table from,
- * and the minimum usage count allowed when pruning.
+ * the minimum usage count allowed when pruning,
+ * the stream options (OPT_ flags) to use,
+ * the number of input bytes and milliseconds of idle input after
+ * which to sync-flush (0 for never),
+ * and the names of the checkpoint files to save to at each sync-flush and
+ * at the end of the input (instead of ending the stream) and to resume
+ * from (without writing a header; the other flags then come from it),
+ * either 0 for none.
  */
-void encode(long maxBits, char *out, char *in, long prune);
+void encode(long maxBits, char *out, char *in, long prune, long options,
+			long syncBytes, long idle, char *keep, char *resume);
 
 /*
  * Recursively prints elements starting from their position in the table
@@ -63,33 +500,158 @@ void encode(long maxBits, char *out, char *in, long prune);
  */
 void decodePrint(struct elt **arrayTable, int C);
 
+/*
+ * Prints the symbol c (one byte, or two if wide is set), through the
+ * filters of the stream if it has any.
+ */
+void decodeSymbol(int c, int wide);
+
+/*
+ * Undoes the filters on the symbols printed by decodeSymbol so far and
+ * writes the result.
+ */
+void decodeFlush(void);
+
+/*
+ * Increments the usage counts of the element with code C and of all
+ * of its prefixes in the array table, the counts pruning and eviction
+ * go by, as encode does.
+ */
+void decodeCount(Table tarr, int C);
+
+/*
+ * Doubles the array table until it can hold curr (the hashtable grows
+ * by itself as elements are inserted).
+ */
+void decodeGrow(Table tarr, int curr);
+
+/*
+ * Prunes the tables in decode after counting the last code read
+ * and returns the number of bits needed afterwards.
+ */
+long decodePrune(long maxBits, long prune, Table *tarr, Table *t, int oldC,
+					long options);
+
 /*
  * This function decodes the input stream sent from encode.
  * It takes in a strings for the file to print a table to.
+ * Version 1 streams (no "V" header) signal width increases and pruning
+ * with BIT_FLAG and PRUNE_FLAG; version 2 streams derive both from the
+ * size of the table, as well as which codes are reused under OPT_EVICT.
+ * keep and resume name checkpoint files as in encode: decode saves its
+ * state at each sync-flush and at the end of a stream cut by encode -k,
+ * and resumes reading the stream where such a checkpoint left off.
+ * If test is set, the stream is checked but not printed: decode prints
+ * the length and hash (see testPrint) of what it would have printed.
+ */
+void decode(char *out, char *keep, char *resume, int test);
+
+/*
+ * Sets up the sums decode --test keeps for each code, giving the literals
+ * theirs.
+ */
+void testCreate(long maxBits);
+
+/*
+ * Works out the length and hash of the string of code C (and of any
+ * prefixes not yet worked out) from the sums of its prefix.
+ */
+void testSum(struct elt **arrayTable, int C);
+
+/*
+ * Adds the string of code C to the length and hash of the output, in
+ * place of printing it. The hash of bytes b[0] ... b[n-1] is the sum of
+ * b[i] * SUM_BASE^(n-1-i) modulo 2^64, so the hash of a string followed
+ * by another is the hash of the first times SUM_BASE to the length of the
+ * second plus the hash of the second, and a code costs the same however
+ * long its string.
+ */
+void testPrint(struct elt **arrayTable, int C);
+
+/*
+ * Adds byte b to the length and hash of the output.
+ */
+void testByte(int b);
+
+/*
+ * Adds the output of the filters to the length and hash of the output;
+ * the write function of the stream decodeFlush writes to under --test.
+ */
+ssize_t testWrite(void *cookie, const char *buf, size_t size);
+
+/*
+ * Reads the header of a stream into the values it gives (in is 0 if there
+ * is no in-table) and returns the number of bytes read.
+ */
+long decodeHeader(long *version, long *maxBits, long *prune, long *options,
+					char **in);
+
+/*
+ * Saves the state of decode just after a sync-flush to the file named name,
+ * as encodeCheckpoint. inBase is the number of bytes of the stream read
+ * before the codes counted by bitsRead (or the Huffman stage).
+ */
+void decodeCheckpoint(char *name, struct checkpoint *k, Table tarr,
+						long numBits, int curr, struct evict *ev,
+						long inBase, long outBytes);
+
+/*
+ * Reads the argument of a flag taking a count (-j, -s or -t).
+ * Returns -1 if it is not a positive number.
+ */
+long countArg(char *arg);
+
+/*
+ * Returns whether encode can be called with these arguments,
+ * checked the same way as the flags of encode (used by lzwd).
  */
-void decode(char *out);
+int optionsValid(long maxBits, long prune, long options);
 
 int main(int argc, char **argv){
 	long maxBits=12;//max number of bits allowed
+	int maxGiven = 0;//whether maxBits was given with -m
 	char *out = 0;//name of file to print table to
 	char *in = 0;//name of file to read table from
 	long prune=0;//minimum usage count upon pruning
+	long options=0;//stream options
+	char *list = 0;//name of file listing members of an archive
+	int archive = 0;//whether decode reads an archive
+	long jobs = sysconf(_SC_NPROCESSORS_ONLN);//workers used for archives
+	long syncBytes = 0;//input bytes between sync-flushes
+	long idle = 0;//milliseconds of idle input before sync-flushing
+	int tune = 0;//how -m auto chooses maxBits, if used
+	char *socketName = 0;//socket of lzwd, to send the request to
+	char *keep = 0;//checkpoint file saved at each sync-flush and the end
+	char *resume = 0;//checkpoint file to carry on from
+	int filters;//FILTER_ flags given by -f
+	int test = 0;//whether decode checks the stream without printing it
+	int stats = 0;//whether encode reports the hit rate of its pair cache
+	char **tables = 0;//in-tables lzwd builds tables with ahead of time
+	int nTables = 0;//number of tables
 	long currM;//the maxBits value to send to encode
 	char *end;//used in strtol to check for errors
 
 	char *program = malloc(sizeof(char) * 7);//name of program being called
 
-	//populate name of program
-	for(int i=0;i<6;i++){
-		program[i] = argv[0][strlen(argv[0])-6+i];
-	}
-	program[6] = '\0';
+	//populate name of program with (up to) its last 6 characters
+	size_t nameLength = strlen(argv[0]);//length of name of program
+	strcpy(program,argv[0] + ((nameLength > 6) ? (nameLength - 6) : 0));
+	nameLength = strlen(program);
 
 	if(strcmp(program,"encode")==0){
 		for(int i=1;i<argc;i++){
 			if(strcmp(argv[i],"-m")==0){
 				i++;
 				if(i < argc){
+					if(strcmp(argv[i],"auto")==0){
+						//choose maxBits by the size of trial encodes
+						tune = AUTO_SIZE;
+						continue;
+					} else if(strcmp(argv[i],"auto-speed")==0){
+						//choose maxBits by size and speed of trial encodes
+						tune = AUTO_SPEED;
+						continue;
+					}
 					//read in m flag
 					currM = strtol(argv[i],&end,10);
 					if((errno == ERANGE) || ((*end) != '\0')){
@@ -116,6 +678,8 @@ int main(int argc, char **argv){
 				} else{
 					maxBits = currM;
 				}
+				maxGiven = 1;
+				tune = 0;
 			} else if(strcmp(argv[i],"-o")==0){
 				i++;
 				if(i < argc){
@@ -162,6 +726,91 @@ int main(int argc, char **argv){
 					free(program);
 					return 1;
 				}
+			} else if(strcmp(argv[i],"-e")==0){
+				//entropy code the codes written
+				options |= OPT_ENTROPY;
+			} else if(strcmp(argv[i],"-l")==0){
+				//evict cold codes one at a time once the table is full
+				options |= OPT_EVICT;
+			} else if(strcmp(argv[i],"-u")==0){
+				//renumber the codes kept by pruning hottest first
+				options |= OPT_HOT;
+			} else if(strcmp(argv[i],"-w")==0){
+				//code 16-bit symbols instead of bytes
+				options |= OPT_WIDE;
+			} else if(strcmp(argv[i],"-f")==0){
+				i++;
+				if(i >= argc){
+					//reached end of argument list before filter names
+					fprintf(stderr,"LZW: -f needs another argument \n");
+					free(program);
+					return 1;
+				} else if((filters = FilterParse(argv[i])) == -1){
+					fprintf(stderr,"LZW: -f takes rle and one of delta, "
+							"delta2 or delta4, separated by commas\n");
+					free(program);
+					return 1;
+				}
+				options |= (long) filters << OPT_FILTER_SHIFT;
+			} else if(strcmp(argv[i],"-v")==0){
+				//report how often the pair cache and jumps were used
+				stats = 1;
+			} else if(strcmp(argv[i],"-k")==0 || strcmp(argv[i],"-r")==0){
+				i++;
+				if(i >= argc){
+					//reached end of argument list before checkpoint name
+					fprintf(stderr,"LZW: %s needs another argument \n",
+							argv[i-1]);
+					free(program);
+					return 1;
+				} else if(argv[i-1][1] == 'k'){
+					keep = argv[i];
+				} else{
+					resume = argv[i];
+				}
+			} else if(strcmp(argv[i],"-a")==0){
+				i++;
+				if(i < argc){
+					list = argv[i];
+				} else{
+					//reached end of argument list before list name
+					fprintf(stderr,"LZW: %s needs another argument \n",
+							argv[i-1]);
+					free(program);
+					return 1;
+				}
+			} else if(strcmp(argv[i],"-j")==0){
+				i++;
+				if(i >= argc || (jobs = countArg(argv[i])) == -1){
+					fprintf(stderr,"LZW: Error reading in -j flag\n");
+					free(program);
+					return 1;
+				}
+			} else if(strcmp(argv[i],"-c")==0){
+				i++;
+				if(i < argc){
+					socketName = argv[i];
+				} else{
+					//reached end of argument list before socket name
+					fprintf(stderr,"LZW: %s needs another argument \n",
+							argv[i-1]);
+					free(program);
+					return 1;
+				}
+			} else if(strcmp(argv[i],"-s")==0){
+				i++;
+				if(i >= argc || (syncBytes = countArg(argv[i])) == -1){
+					fprintf(stderr,"LZW: Error reading in -s flag\n");
+					free(program);
+					return 1;
+				}
+			} else if(strcmp(argv[i],"-t")==0){
+				i++;
+				if(i >= argc || (idle = countArg(argv[i])) == -1){
+					fprintf(stderr,"LZW: Error reading in -t flag\n");
+					free(program);
+					return 1;
+				}
 			} else{
 				//flag is not one of those allowed
 				fprintf(stderr,"LZW: %s is not a valid flag\n",
@@ -170,8 +819,79 @@ int main(int argc, char **argv){
 				return 1;
 			}
 		}
+		if((options & OPT_EVICT) && (prune != 0)){
+			//pruning and eviction both free codes of a full table
+			fprintf(stderr,"LZW: -l and -p cannot be used together\n");
+			free(program);
+			return 1;
+		}
+		if(((keep != 0) || (resume != 0))
+			&& ((list != 0) || (socketName != 0) || (tune != 0))){
+			//checkpoints are of a single stream encoded here
+			fprintf(stderr,"LZW: -k and -r cannot be used with -a, -c "
+					"or -m auto\n");
+			free(program);
+			return 1;
+		}
+		if((resume != 0) && (maxGiven || (prune != 0) || (options != 0)
+								|| (in != 0))){
+			//the stream being resumed already has these
+			fprintf(stderr,"LZW: -r takes -m, -p, -i, -e, -l, -u, -w and -f "
+					"from the checkpoint\n");
+			free(program);
+			return 1;
+		}
+		if((options & OPT_WIDE) && !maxGiven && (tune == 0)){
+			//the 12-bit default cannot hold the wide literals
+			maxBits = 20;
+		}
+		if((options & OPT_WIDE)
+			&& ((tune != 0) || ((1 << maxBits) <= AFTER_WIDE))){
+			//codes must hold the 65536 literals and more
+			fprintf(stderr,"LZW: -w needs -m 17 or more (not auto)\n");
+			free(program);
+			return 1;
+		}
+		if((list != 0) && (out != 0)){
+			//each group of an archive ends with its own table
+			fprintf(stderr,"LZW: -a and -o cannot be used together\n");
+			free(program);
+			return 1;
+		}
+		if((list != 0) && (tune != 0)){
+			//groups of an archive are not sampled
+			fprintf(stderr,"LZW: -a and -m auto cannot be used together\n");
+			free(program);
+			return 1;
+		}
+		if((socketName != 0) && ((list != 0) || (out != 0) || (tune != 0)
+									|| (syncBytes != 0) || (idle != 0))){
+			//lzwd only encodes whole inputs with fixed flags
+			fprintf(stderr,"LZW: -c cannot be used with -a, -o, -s, -t "
+					"or -m auto\n");
+			free(program);
+			return 1;
+		}
+		if(stats && ((list != 0) || (socketName != 0))){
+			//the streams are encoded by other processes
+			fprintf(stderr,"LZW: -v cannot be used with -a or -c\n");
+			free(program);
+			return 1;
+		}
+		if(tune != 0){
+			autoTune(&maxBits,&prune,in,options,jobs,tune);
+		}
 		//encode using the flags read in
-		encode(maxBits,out,in,prune);
+		if(socketName != 0){
+			DaemonRequest(socketName,'E',maxBits,prune,options,in);
+		} else if(list != 0){
+			ArchiveEncode(list,jobs,maxBits,in,prune,options);
+		} else{
+			encode(maxBits,out,in,prune,options,syncBytes,idle,keep,resume);
+			if(stats){
+				cacheReport();
+			}
+		}
 	} else if(strcmp(program,"decode")==0){
 		for(int i=1;i<argc;i++){
 			if(strcmp(argv[i],"-o")==0){
@@ -185,231 +905,1462 @@ int main(int argc, char **argv){
 					free(program);
 					return 1;
 				}
-			} else{
-				//flag is not one of those allowed
-				fprintf(stderr,"LZW: %s is not a valid flag\n",argv[i]);
-				free(program);
-				return 1;
-			}
-		}
-		//encode using the flags read in
-		decode(out);
-	} else{
-		//name of program is not one of those allowed
-		fprintf(stderr,"LZW: argument should call encode or decode\n");
-		free(program);
+			} else if(strcmp(argv[i],"-a")==0){
+				//read an archive and write its members
+				archive = 1;
+			} else if(strcmp(argv[i],"--test")==0){
+				//check the stream and print its length and hash instead
+				test = 1;
+			} else if(strcmp(argv[i],"-k")==0 || strcmp(argv[i],"-r")==0){
+				i++;
+				if(i >= argc){
+					//reached end of argument list before checkpoint name
+					fprintf(stderr,"LZW: %s needs another argument \n",
+							argv[i-1]);
+					free(program);
+					return 1;
+				} else if(argv[i-1][1] == 'k'){
+					keep = argv[i];
+				} else{
+					resume = argv[i];
+				}
+			} else if(strcmp(argv[i],"-c")==0){
+				i++;
+				if(i < argc){
+					socketName = argv[i];
+				} else{
+					//reached end of argument list before socket name
+					fprintf(stderr,"LZW: %s needs another argument \n",
+							argv[i-1]);
+					free(program);
+					return 1;
+				}
+			} else if(strcmp(argv[i],"-j")==0){
+				i++;
+				if(i >= argc || (jobs = countArg(argv[i])) == -1){
+					fprintf(stderr,"LZW: Error reading in -j flag\n");
+					free(program);
+					return 1;
+				}
+			} else{
+				//flag is not one of those allowed
+				fprintf(stderr,"LZW: %s is not a valid flag\n",argv[i]);
+				free(program);
+				return 1;
+			}
+		}
+		if(archive && (out != 0)){
+			//each group of an archive ends with its own table
+			fprintf(stderr,"LZW: -a and -o cannot be used together\n");
+			free(program);
+			return 1;
+		}
+		if((socketName != 0) && (archive || (out != 0))){
+			//lzwd only decodes single streams and keeps no tables
+			fprintf(stderr,"LZW: -c cannot be used with -a or -o\n");
+			free(program);
+			return 1;
+		}
+		if(((keep != 0) || (resume != 0)) && (archive || (socketName != 0))){
+			//checkpoints are of a single stream decoded here
+			fprintf(stderr,"LZW: -k and -r cannot be used with -a or -c\n");
+			free(program);
+			return 1;
+		}
+		if(test && ((keep != 0) || (resume != 0) || (socketName != 0))){
+			//a test runs over a whole stream here
+			fprintf(stderr,"LZW: --test cannot be used with -k, -r or -c\n");
+			free(program);
+			return 1;
+		}
+		//decode using the flags read in
+		if(socketName != 0){
+			DaemonRequest(socketName,'D',0,0,0,0);
+		} else if(archive){
+			ArchiveDecode(jobs,test);
+		} else{
+			decode(out,keep,resume,test);
+		}
+	} else if(nameLength >= 4 && strcmp(program+nameLength-4,"lzwd")==0){
+		tables = malloc(sizeof(char *) * argc);
+		for(int i=1;i<argc;i++){
+			if(strcmp(argv[i],"-i")==0 && i+1 < argc){
+				//build tables with this in-table ahead of time
+				tables[nTables++] = argv[++i];
+			} else if(strcmp(argv[i],"-j")==0){
+				i++;
+				if(i >= argc || (jobs = countArg(argv[i])) == -1){
+					fprintf(stderr,"LZW: Error reading in -j flag\n");
+					free(tables);
+					free(program);
+					return 1;
+				}
+			} else if(argv[i][0] != '-' && socketName == 0){
+				socketName = argv[i];
+			} else{
+				//flag is not one of those allowed
+				fprintf(stderr,"LZW: %s is not a valid flag\n",argv[i]);
+				free(tables);
+				free(program);
+				return 1;
+			}
+		}
+		if(socketName == 0){
+			fprintf(stderr,"LZW: lzwd needs the name of a socket\n");
+			free(tables);
+			free(program);
+			return 1;
+		}
+		//serve requests until killed
+		DaemonServe(socketName,jobs,tables,nTables);
+	} else{
+		//name of program is not one of those allowed
+		fprintf(stderr,"LZW: argument should call encode, decode or lzwd\n");
+		free(program);
+		return 1;
+	}
+	free(program);
+	return 0;
+}
+
+long countArg(char *arg){
+	char *end;//used in strtol to check for errors
+	long jobs;//number read
+
+	errno = 0;
+	jobs = strtol(arg,&end,10);
+	if((errno == ERANGE) || ((*end) != '\0') || (jobs <= 0)){
+		return -1;
+	}
+	return jobs;
+}
+
+int optionsValid(long maxBits, long prune, long options){
+	return (maxBits > 8) && (maxBits <= 20) && (prune >= 0)
+			&& ((options & ~OPT_ALL) == 0)
+			&& FilterValid((options & OPT_FILTERS) >> OPT_FILTER_SHIFT)
+			&& !((options & OPT_EVICT) && (prune != 0))
+			&& !((options & OPT_WIDE) && ((1 << maxBits) <= AFTER_WIDE));
+}
+
+void symbolsSet(long options){
+	afterLiterals = (options & OPT_WIDE) ? AFTER_WIDE : AFTER_ASCII;
+}
+
+void symbolWrite(FILE *output, int c){
+	putc(c & UCHAR_MAX,output);
+	if(afterLiterals == AFTER_WIDE){
+		putc(c >> CHAR_BIT,output);
+	}
+}
+
+int symbolRead(FILE *input){
+	int c = getc(input);//low byte
+	int high;//high byte of a wide symbol
+
+	if(c == EOF || afterLiterals != AFTER_WIDE){
+		return c;
+	}
+	if((high = getc(input)) == EOF){
+		return EOF;
+	}
+	return c | (high << CHAR_BIT);
+}
+
+int pruneTable(long maxBits, long prune, Table *tarr, Table *t, int initSize,
+				int hot){
+	Table tnew = TableCreate(1 << initSize);//new hashtable
+	Table tarrnew = TableCreate(1 << initSize);//new array version of table
+	int endSize = initSize;//number of bits needed at end
+	struct survivor *kept = malloc(sizeof(struct survivor) * (*tarr)->n);
+	int nKept = 0;//number of elements kept
+	struct elt *e;//element being kept
+
+	//array whose indices are old codes and values are corresponding new codes
+	//used to determine the new prefix of elements when inserting
+	int *newCodes = malloc(sizeof(int) * (*t)->n);
+	for(int i=0;i<(*t)->n;i++){
+		newCodes[i] = -1;
+	}
+
+	//initialize our table with ASCII values
+	for(int i=2;i<afterLiterals;i++){
+		TableInsert(&tnew,i,EMPTY,i-2,maxBits,0);
+		TableLinearInsert(&tarrnew,i,EMPTY,i-2,maxBits,i);
+		newCodes[i] = i;
+	}
+
+	for(int i=afterLiterals;i<(*tarr)->n;i++){
+		//if values usage count is above prune, keep it
+		if(((*tarr)->table[i] != 0) && (*tarr)->table[i]->usagecount >= prune){
+			kept[nKept].usage = (*tarr)->table[i]->usagecount;
+			kept[nKept].code = i;
+			nKept++;
+		}
+	}
+	if(hot){
+		//hot strings get the low codes, which share a few cache lines
+		qsort(kept,nKept,sizeof(struct survivor),survivorCompare);
+	}
+
+	int curr = afterLiterals;//current index being inserted in array
+	for(int i=0;i<nKept;i++){
+		e = (*tarr)->table[kept[i].code];
+		//record oldcode-newcode association
+		newCodes[e->code] = tnew->n;
+		//somehow the prefix hasn't been associated
+		if(newCodes[e->prefix] == -1){
+			fprintf(stderr, "LZW: Table Corrupt\n");
+			return -1;
+		}
+		//insert the element into the table and the array version of the table
+		if(TableInsert(&tnew,tnew->n,newCodes[e->prefix],e->c,maxBits,0)){
+			endSize++;
+		}
+		TableLinearInsert(&tarrnew,tarrnew->n,newCodes[e->prefix],e->c,
+							maxBits,curr);
+		curr++;
+	}
+
+	//make t and tarr point to the new tables
+	tablesDestroy(*t,*tarr);
+	free(newCodes);
+	free(kept);
+	(*t) = tnew;
+	(*tarr) = tarrnew;
+
+	//if we exactly filled up the table
+	if((*t)->n == (1 << (endSize))){
+		endSize++;
+	}
+	return endSize;
+}
+
+int survivorCompare(const void *a, const void *b){
+	const struct survivor *x = a;
+	const struct survivor *y = b;
+
+	if(x->usage != y->usage){
+		return (x->usage > y->usage) ? -1 : 1;
+	}
+	return x->code - y->code;
+}
+
+//Tables built by tablesPreload, waiting to be handed out by tablesCreate
+struct ready{
+	long maxBits;//maxBits the tables were built for
+	int literals;//afterLiterals the tables were built for
+	char *in;//full path of the in-table (0 for none)
+	int n;//number of elements (and next code) of the tables
+	int size;//size of the array table, which version 1 streams depend on
+	Table t;//hashtable
+	Table tarr;//array table
+	Trie trie;//trie of the tables if they are full (0 if not)
+	struct ready *next;//next tables built
+};
+static struct ready *readyTables = 0;
+//Tables lent by tablesCreate, to be given back to tablesDestroy
+static struct ready *lentTables = 0;
+//Code, prefix and character of each element of lentTables evicted,
+//in the order evicted
+static int *lentEvicted = 0;
+static long nLentEvicted = 0;
+static long lentEvictedSize = 0;
+//Codes of the elements of lentTables whose usage count has left 0
+static int *lentCounted = 0;
+static long nLentCounted = 0;
+static long lentCountedSize = 0;
+
+/*
+ * Builds the tables as tablesCreate does, returning 1 if they were built,
+ * 0 if the in-table could not be opened and -1 if it is corrupt
+ */
+static int tablesRead(long maxBits, char *in, Table *t, Table *tarr){
+	int start=2;//0 and 1 stay reserved as in version 1 streams
+	*t = TableCreate(1 << INITIAL_BITS);
+	*tarr = TableCreate(1 << INITIAL_BITS);
+
+	//initialize table with ASCII values
+	for(int i=start;i<afterLiterals;i++){
+		TableInsert(t,i,EMPTY,i-start,maxBits,0);
+		TableLinearInsert(tarr,i,EMPTY,i-start,maxBits,i);
+	}
+	if(in == 0){
+		return 1;
+	}
+
+	int inP;//prefix read in in-table
+	int inC;//symbol read in in-table
+	int inTableRead;//current read from in-table
+	FILE *input = fopen(in,"r");
+	if(input == 0){
+		//file not opened for whatever reason
+		return 0;
+	}
+	//read in table from in
+	while((inTableRead = fgetc(input)) != EOF){
+		inP = fgetBits(MAX_MAX_BITS,input);
+		inC = symbolRead(input);
+		if(inTableRead != ':' || inP < start || inP >= (*tarr)->n
+			|| inC == EOF){
+			//did not fit style of table that I used
+			//or prefix not in table yet
+			fclose(input);
+			return -1;
+		}
+		//insert values into table
+		TableInsert(t,(*t)->n,inP,inC,maxBits,0);
+		TableLinearInsert(tarr,(*tarr)->n,inP,inC,maxBits,(*tarr)->n);
+	}
+	fclose(input);
+	return 1;
+}
+
+/*
+ * Notes that the usage count of the element of tarr with code has left 0,
+ * for tablesDestroy to clear if tarr was lent
+ */
+static void tablesCounted(Table tarr, int code){
+	struct ready *r = lentTables;//tables lent, if tarr is
+
+	if(r == 0 || r->tarr != tarr || code >= r->n){
+		return;
+	}
+	if(nLentCounted == lentCountedSize){
+		lentCountedSize = (lentCountedSize == 0) ? 1024 : lentCountedSize*2;
+		lentCounted = realloc(lentCounted,sizeof(int) * lentCountedSize);
+	}
+	lentCounted[nLentCounted++] = code;
+}
+
+void tablesCreate(long maxBits, char *in, Table *t, Table *tarr){
+	char *path = 0;//full path of the in-table
+	struct ready *r;//tables being looked at
+
+	if(readyTables != 0 && in != 0){
+		path = realpath(in,0);
+	}
+	for(r = readyTables; r != 0; r = r->next){
+		if(r->maxBits == maxBits && r->literals == afterLiterals
+			&& ((r->in == 0 && in == 0)
+			|| (r->in != 0 && path != 0 && strcmp(r->in,path) == 0))){
+			break;
+		}
+	}
+	free(path);
+	if(r != 0){
+		lentTables = r;
+		nLentEvicted = 0;
+		nLentCounted = 0;
+		*t = r->t;
+		*tarr = r->tarr;
+		return;
+	}
+
+	int read = tablesRead(maxBits,in,t,tarr);//whether the tables were built
+	if(read == 0){
+		fprintf(stderr, "LZW: Could not open file\n");
+		exit(1);
+	} else if(read == -1){
+		fprintf(stderr, "LZW: In-Table Corrupt\n");
+		exit(1);
+	}
+}
+
+int tablesPreload(long maxBits, char *in){
+	struct ready *r = malloc(sizeof(struct ready));
+	if(tablesRead(maxBits,in,&r->t,&r->tarr) != 1){
+		TableDestroy(r->t);
+		TableDestroy(r->tarr);
+		free(r);
+		return 0;
+	}
+	r->maxBits = maxBits;
+	r->literals = afterLiterals;
+	r->in = (in == 0) ? 0 : realpath(in,0);
+	r->n = r->tarr->n;
+	r->size = r->tarr->size;
+	r->trie = (r->n == (1 << maxBits)) ? trieFreeze(r->tarr) : 0;
+	r->next = readyTables;
+	readyTables = r;
+	return 1;
+}
+
+/*
+ * Takes the element with code out of hashtable t and returns it
+ * (0 if it is not in the chain of its element in tarr).
+ * By code as decode can add an element with the same prefix and character
+ * as another.
+ */
+static struct elt *tablesUnlink(Table t, Table tarr, int code){
+	struct elt **prev;//link to the element being looked at
+	struct elt *e = tarr->table[code];
+
+	for(prev = &t->table[HASH(e->prefix,e->c,t->size)]; *prev != 0;
+		prev = &(*prev)->next){
+		if((*prev)->code == code){
+			e = *prev;
+			*prev = e->next;
+			return e;
+		}
+	}
+	return 0;
+}
+
+void tablesDestroy(Table t, Table tarr){
+	struct ready *r = lentTables;//tables lent, if these are
+	struct elt *e;
+	int found = 1;//whether every element changed was found
+	int *old;//code, prefix and character of an element evicted
+
+	if(r == 0 || r->tarr != tarr){
+		TableDestroy(t);
+		TableDestroy(tarr);
+		return;
+	}
+	lentTables = 0;
+	//clear the usage counts counted, as nothing else does
+	while(nLentCounted > 0){
+		tarr->table[lentCounted[--nLentCounted]]->usagecount = 0;
+	}
+	//put back the elements evicted, latest first
+	while(nLentEvicted > 0){
+		old = &lentEvicted[3 * (--nLentEvicted)];
+		if((e = tablesUnlink(t,tarr,old[0])) == 0){
+			found = 0;
+			break;
+		}
+		e->prefix = tarr->table[old[0]]->prefix = old[1];
+		e->c = tarr->table[old[0]]->c = old[2];
+		e->next = t->table[HASH(e->prefix,e->c,t->size)];
+		t->table[HASH(e->prefix,e->c,t->size)] = e;
+	}
+	//take out the elements added
+	for(int i=r->n;found && i<tarr->n;i++){
+		if((e = tablesUnlink(t,tarr,i)) == 0){
+			found = 0;
+			break;
+		}
+		free(e);
+		(t->n)--;
+		free(tarr->table[i]);
+		tarr->table[i] = 0;
+	}
+	if(!found || t->n != r->n){
+		//not all found; build them again rather than lend them broken
+		TableDestroy(t);
+		TableDestroy(tarr);
+		tablesRead(r->maxBits,r->in,&r->t,&r->tarr);
+		return;
+	}
+	tarr->n = r->n;
+	tarr->size = r->size;
+	tarr->table = realloc(tarr->table,sizeof(*tarr->table) * tarr->size);
+	//TableInsert may have moved the hashtable to grow it
+	r->t = t;
+}
+
+int codeWidth(int n){
+	int bits = INITIAL_BITS;//number of bits needed
+	while((1 << bits) < n){
+		bits++;
+	}
+	return bits;
+}
+
+struct evict *evictCreate(long maxBits, Table tarr){
+	struct evict *ev = malloc(sizeof(struct evict));
+	ev->children = calloc(1 << maxBits,sizeof(int));
+	ev->hand = afterLiterals;
+	for(int i=afterLiterals;i<tarr->n;i++){
+		(ev->children[tarr->table[i]->prefix])++;
+	}
+	return ev;
+}
+
+void evictDestroy(struct evict *ev){
+	if(ev != 0){
+		free(ev->children);
+		free(ev);
+	}
+}
+
+int evictCode(struct evict *ev, Table tarr, long maxBits, int keep){
+	int code;//code being looked at
+	int leaf = EMPTY;//first leaf passed, used if none has decayed
+	struct elt *e;//element being looked at
+
+	for(int i=0;i<EVICT_SCAN;i++){
+		code = ev->hand;
+		//move the hand on, wrapping around past the ASCII values
+		ev->hand = (code + 1 < (1 << maxBits)) ? (code + 1) : afterLiterals;
+		if(code == keep || ev->children[code] != 0){
+			//not a leaf or about to become a prefix
+			continue;
+		}
+		e = tarr->table[code];
+		if(e->usagecount == 0){
+			return code;
+		}
+		//give the leaf a second chance but let its count decay
+		e->usagecount /= 2;
+		if(leaf == EMPTY){
+			leaf = code;
+		}
+	}
+	return leaf;
+}
+
+void evictInsert(struct evict *ev, Table *t, Table tarr,
+					int victim, int prefix, int c, long maxBits){
+	if(victim == EMPTY){
+		return;
+	}
+	struct elt *e = tarr->table[victim];//element whose code is reused
+	struct ready *r = lentTables;//tables lent, if these are
+
+	if(r != 0 && r->tarr == tarr && victim < r->n){
+		//remember the element lent for tablesDestroy to put back
+		if(nLentEvicted == lentEvictedSize){
+			lentEvictedSize = (lentEvictedSize == 0) ? 64 : lentEvictedSize*2;
+			lentEvicted = realloc(lentEvicted,
+								sizeof(int) * 3 * lentEvictedSize);
+		}
+		lentEvicted[3 * nLentEvicted] = victim;
+		lentEvicted[3 * nLentEvicted + 1] = e->prefix;
+		lentEvicted[3 * nLentEvicted + 2] = e->c;
+		nLentEvicted++;
+	}
+	TableDelete(*t,e->prefix,e->c);
+	(ev->children[e->prefix])--;
+	e->prefix = prefix;
+	e->c = c;
+	e->usagecount = 0;
+	TableInsert(t,victim,prefix,c,maxBits,0);
+	(ev->children[prefix])++;
+}
+
+void writeTable(FILE *output, Table tarr){
+	int *newCodes = malloc(sizeof(int) * tarr->n);//code of element in output
+	int *stack = malloc(sizeof(int) * tarr->n);//elements waiting for prefix
+	int top;//number of elements on stack
+	int next = afterLiterals;//code of next element printed
+
+	for(int i=0;i<tarr->n;i++){
+		newCodes[i] = (i < afterLiterals) ? i : EMPTY;
+	}
+	for(int i=afterLiterals;i<tarr->n;i++){
+		//print element after any prefixes not yet printed
+		top = 0;
+		for(int j=i;newCodes[j] == EMPTY;j = tarr->table[j]->prefix){
+			stack[top++] = j;
+		}
+		while(top > 0){
+			int j = stack[--top];//element printed
+			newCodes[j] = next++;
+			//To check for corruption and to check when we're done
+			fputc(':',output);
+			fputBits(MAX_MAX_BITS,newCodes[tarr->table[j]->prefix],output);
+			symbolWrite(output,tarr->table[j]->c);
+		}
+	}
+	free(newCodes);
+	free(stack);
+}
+
+//Bits written by writeCode and read by readCode, to find the padding
+//after a sync-flush
+static long bitsWritten = 0;
+static long bitsRead = 0;
+
+//Lookups of encoderStep and how many of them the pair cache answered
+static long cacheLookups = 0;
+static long cacheHits = 0;
+//Bytes encode skipped with jumps
+static long jumpedBytes = 0;
+
+//Input of decode unpacked by bulkGet
+static int bulk = 0;//whether readCode goes through bulkGet
+static unsigned char bulkIn[BULK_BYTES + 8];//input read ahead
+static long bulkLen = 0;//bytes in bulkIn
+static long bulkBit = 0;//bit of bulkIn where bulkCodes starts
+static int bulkCodes[BULK_CODES];//codes unpacked
+static int bulkCount = 0;//codes in bulkCodes
+static int bulkNext = 0;//next code of bulkCodes to return
+static int bulkWidth = 0;//bits in each code of bulkCodes
+
+//Bytes printed by decode, for its checkpoints
+static long decodedBytes = 0;
+
+//Filters decode undoes on its output, 0 if none
+static Filter outFilter = 0;
+//Where decodeFlush writes the output of outFilter
+static FILE *filterOutput = 0;
+
+//Sums kept by decode --test for the string of each code, see struct sum
+static struct sum *sums = 0;
+//Length and hash of the output so far
+static long testLength = 0;
+static uint64_t testHash = 0;
+//Bytes decoded but not yet through outFilter
+static unsigned char outBuffer[BUFSIZ];
+static int outLen = 0;
+
+//Whether a sync-flush has been asked for through syncRequest
+static volatile sig_atomic_t syncRequested = 0;
+
+//Input of encode, read a buffer at a time so that encode can tell
+//when it has read everything available
+static unsigned char inBuffer[BUFSIZ];
+static unsigned char *inData = inBuffer;//inBuffer or the sample of autoTune
+static long inPos = 0;
+static long inLen = 0;
+
+void writeCode(long options, long numBits, int C){
+	if(options & OPT_ENTROPY){
+		HuffPut(C);
+	} else{
+		putBits(numBits,C);
+		bitsWritten += numBits;
+	}
+}
+
+int readCode(long options, long numBits){
+	if(options & OPT_ENTROPY){
+		return HuffGet();
+	}
+	bitsRead += numBits;
+	if(bulk){
+		return bulkGet(numBits);
+	}
+	return getBits(numBits);
+}
+
+void bulkStart(long options){
+	struct stat st;//what standard input is
+
+	bulk = !(options & OPT_ENTROPY) && fstat(STDIN_FILENO,&st) == 0
+			&& S_ISREG(st.st_mode);
+	bulkLen = 0;
+	bulkBit = 0;
+	bulkCount = 0;
+	bulkNext = 0;
+	bulkWidth = 0;
+}
+
+int bulkGet(int numBits){
+	if(bulkNext == bulkCount || numBits != bulkWidth){
+		if(bulkFill(numBits) == 0){
+			return EOF;
+		}
+	}
+	return bulkCodes[bulkNext++];
+}
+
+int bulkFill(int numBits){
+	long skip;//bytes of bulkIn already used
+	size_t got;//bytes read
+	long n;//codes in the input read ahead
+
+	//codes not returned yet are unpacked again, perhaps at a new width
+	bulkBit += (long) bulkNext * bulkWidth;
+	skip = bulkBit / CHAR_BIT;
+	memmove(bulkIn,bulkIn + skip,bulkLen - skip);
+	bulkLen -= skip;
+	bulkBit -= skip * CHAR_BIT;
+	while(bulkLen < BULK_BYTES
+			&& (got = fread(bulkIn + bulkLen,1,BULK_BYTES - bulkLen,stdin))){
+		bulkLen += got;
+	}
+	memset(bulkIn + bulkLen,0,8);
+	n = (bulkLen * CHAR_BIT - bulkBit) / numBits;
+	if(n > BULK_CODES){
+		n = BULK_CODES;
+	}
+	bulkUnpack(bulkIn,bulkBit,numBits,bulkCodes,n);
+	bulkWidth = numBits;
+	bulkCount = n;
+	bulkNext = 0;
+	return n;
+}
+
+void bulkUnpack(unsigned char *in, long bit, int nBits, int *codes, int n){
+	unsigned char *p;//first byte holding a code
+	uint64_t w;//the 64 bits from p, first byte highest
+
+	for(int i=0;i<n;i++){
+		p = in + (bit >> 3);
+		w = ((uint64_t) p[0] << 56) | ((uint64_t) p[1] << 48)
+			| ((uint64_t) p[2] << 40) | ((uint64_t) p[3] << 32)
+			| ((uint64_t) p[4] << 24) | ((uint64_t) p[5] << 16)
+			| ((uint64_t) p[6] << 8) | (uint64_t) p[7];
+		codes[i] = (w << (bit & 7)) >> (64 - nBits);
+		bit += nBits;
+	}
+}
+
+void syncRequest(int sig){
+	syncRequested = 1;
+}
+
+long readInput(long idle, long max, unsigned char **data){
+	struct pollfd p = {STDIN_FILENO,POLLIN,0};//used to wait for input
+	ssize_t got;//number of bytes read
+
+	if(syncRequested){
+		return SYNC;
+	}
+	if(inPos == inLen){
+		//a signal interrupting the wait also means a flush was asked for
+		if(idle > 0 && poll(&p,1,idle) <= 0){
+			return SYNC;
+		}
+		if((got = read(STDIN_FILENO,inBuffer,BUFSIZ)) == -1
+			&& errno == EINTR){
+			return SYNC;
+		}
+		if(got <= 0){
+			return EOF;
+		}
+		inData = inBuffer;
+		inLen = got;
+		inPos = 0;
+	}
+	if(max > inLen - inPos){
+		max = inLen - inPos;
+	}
+	*data = inData + inPos;
+	inPos += max;
+	return max;
+}
+
+void autoTune(long *maxBits, long *prune, char *in, long options,
+				long jobs, int tune){
+	unsigned char *sample = malloc(AUTO_SAMPLE);//start of standard input
+	long n = 0;//number of bytes in sample
+	ssize_t got;//number of bytes read
+	int nBits = sizeof(autoBits) / sizeof(autoBits[0]);
+	int nPrunes = sizeof(autoPrunes) / sizeof(autoPrunes[0]);
+	int trials;//number of trial encodes
+	FILE **outs;//output of each trial
+	pid_t *pids;//worker running each trial
+	double *times;//CPU time of each trial, negative if it failed
+	int running = 0;//number of trials running
+	int status;//exit status of a trial
+	struct timespec start;//CPU clock of a trial before it encodes
+	struct timespec end;//CPU clock of a trial after it encodes
+	pid_t pid;
+	int best = -1;//trial chosen
+	long size;//bytes of output of a trial
+	long bestSize = 0;//bytes of output of the trial chosen
+	double score;//score of a trial; lower is better
+	double bestScore = 0;//score of the trial chosen
+
+	while(n < AUTO_SAMPLE){
+		got = read(STDIN_FILENO,sample + n,AUTO_SAMPLE - n);
+		if(got == -1 && errno == EINTR){
+			continue;
+		}
+		if(got <= 0){
+			break;
+		}
+		n += got;
+	}
+	if(*prune != 0 || (options & OPT_EVICT)){
+		//keep the prune given (or 0 with -l)
+		nPrunes = 1;
+	}
+	trials = nBits * nPrunes;
+	outs = malloc(sizeof(FILE *) * trials);
+	pids = malloc(sizeof(pid_t) * trials);
+	//shared so that each trial can leave its time there
+	times = mmap(0,sizeof(double) * trials,PROT_READ | PROT_WRITE,
+					MAP_SHARED | MAP_ANONYMOUS,-1,0);
+	if(times == MAP_FAILED){
+		fprintf(stderr, "LZW: Could not start trial\n");
+		exit(1);
+	}
+
+	for(int k=0;k<=trials;k++){
+		//wait for a trial to finish if enough are running or all started
+		while(running > 0 && (running == jobs || k == trials)){
+			pid = wait(&status);
+			for(int j=0;j<k;j++){
+				if(pids[j] == pid
+					&& (!WIFEXITED(status) || WEXITSTATUS(status) != 0)){
+					times[j] = -1;
+				}
+			}
+			running--;
+		}
+		if(k == trials){
+			break;
+		}
+		times[k] = -1;
+		fflush(stdout);
+		if((outs[k] = tmpfile()) == 0 || (pids[k] = fork()) == -1){
+			fprintf(stderr, "LZW: Could not start trial\n");
+			exit(1);
+		}
+		if(pids[k] == 0){
+			//encode the sample alone into outs[k]
+			dup2(open("/dev/null",O_RDONLY),STDIN_FILENO);
+			dup2(fileno(outs[k]),STDOUT_FILENO);
+			inData = sample;
+			inLen = n;
+			clock_gettime(CLOCK_PROCESS_CPUTIME_ID,&start);
+			encode(autoBits[k / nPrunes],0,in,
+					(nPrunes == 1) ? *prune : autoPrunes[k % nPrunes],
+					options,0,0,0,0);
+			fflush(stdout);
+			clock_gettime(CLOCK_PROCESS_CPUTIME_ID,&end);
+			times[k] = (end.tv_sec - start.tv_sec)
+						+ (end.tv_nsec - start.tv_nsec) / 1e9;
+			exit(0);
+		}
+		running++;
+	}
+
+	for(int k=0;k<trials;k++){
+		fseek(outs[k],0,SEEK_END);
+		score = size = ftell(outs[k]);
+		if(tune == AUTO_SPEED){
+			score *= times[k];
+		}
+		if(times[k] >= 0 && (best == -1 || score < bestScore
+								|| (score == bestScore && size < bestSize))){
+			best = k;
+			bestScore = score;
+			bestSize = size;
+		}
+		fclose(outs[k]);
+	}
+	if(best == -1){
+		fprintf(stderr, "LZW: Trial encodes failed\n");
+		exit(1);
+	}
+	*maxBits = autoBits[best / nPrunes];
+	if(nPrunes != 1){
+		*prune = autoPrunes[best % nPrunes];
+	}
+	free(outs);
+	free(pids);
+	munmap(times,sizeof(double) * trials);
+
+	//encode reads the sample before the rest of standard input
+	inData = sample;
+	inLen = n;
+	inPos = 0;
+}
+
+void syncFlush(long options, long numBits, int C){
+	int pad;//number of bits to the next byte
+
+	if(C != EMPTY){
+		//decode finishes C without waiting for the code after it
+		writeCode(options,numBits,FLUSH_FLAG);
+		writeCode(options,numBits,C);
+	}
+	if(options & OPT_ENTROPY){
+		HuffSync();
+	} else if((pad = (CHAR_BIT - bitsWritten % CHAR_BIT) % CHAR_BIT) != 0){
+		putBits(pad,0);
+		bitsWritten += pad;
+	}
+	fflush(stdout);
+}
+
+void syncAlign(long options){
+	int pad;//number of bits to the next byte
+
+	if(options & OPT_ENTROPY){
+		HuffAlign();
+	} else if((pad = (CHAR_BIT - bitsRead % CHAR_BIT) % CHAR_BIT) != 0){
+		if(bulk){
+			//the next codes start at the byte after the padding
+			bulkBit += (long) bulkNext * bulkWidth + pad;
+			bulkNext = 0;
+			bulkCount = 0;
+		} else{
+			getBits(pad);
+		}
+		bitsRead += pad;
+	}
+}
+
+void codecReset(void){
+	while(getBits(1) != EOF){
+	}
+	clearerr(stdin);
+	HuffReset();
+	bitsWritten = 0;
+	bitsRead = 0;
+	syncRequested = 0;
+	decodedBytes = 0;
+	inData = inBuffer;
+	inPos = 0;
+	inLen = 0;
+}
+
+long encodeHeader(long maxBits, char *in, long prune, long options){
+	//send the stream version and the correct flags to decode
+	if(in == 0){
+		return printf("V%d:%ld:%ld:%ld:%ld:%s\n",STREAM_VERSION,maxBits,
+						prune,options,(unsigned long) 0,"");
+	} else{
+		return printf("V%d:%ld:%ld:%ld:%ld:%s\n",STREAM_VERSION,maxBits,
+						prune,options,strlen(in),in);
+	}
+}
+
+void checkpointWrite(char *name, struct checkpoint *k, Table tarr,
+						Filter filter){
+	char *temp = malloc(strlen(name) + 5);//written first, then renamed
+	FILE *output;//checkpoint being written
+	unsigned int usage;//usage count of an element
+
+	sprintf(temp,"%s.new",name);
+	if((output = fopen(temp,"wb")) == 0){
+		fprintf(stderr, "LZW: Could not open file\n");
+		exit(1);
+	}
+	fprintf(output,"LZWK%d:%c:%ld:%ld:%ld:%d:%ld:%d:%d:%d:%ld:%ld\n",
+			CHECKPOINT_VERSION,k->role,k->maxBits,k->prune,k->options,
+			tarr->n,k->numBits,k->curr,k->hand,k->low,k->inBytes,
+			k->outBytes);
+	if(filter != 0){
+		FilterSave(filter,output);
+	}
+	for(int i=afterLiterals;i<tarr->n;i++){
+		usage = tarr->table[i]->usagecount;
+		fputBits(MAX_MAX_BITS,tarr->table[i]->prefix,output);
+		symbolWrite(output,tarr->table[i]->c);
+		fputBits(16,usage >> 16,output);
+		fputBits(16,usage & 0xFFFF,output);
+	}
+	if(fclose(output) != 0 || rename(temp,name) != 0){
+		fprintf(stderr, "LZW: Could not write checkpoint\n");
+		exit(1);
+	}
+	free(temp);
+}
+
+void checkpointRead(char *name, int role, struct checkpoint *k,
+					Table *t, Table *tarr, Filter *filter){
+	FILE *input = fopen(name,"rb");//checkpoint being read
+	int version;//checkpoint version
+	char found;//role the checkpoint was written for
+	int n;//number of elements in the tables
+	int prefix;//prefix of an element
+	int c;//symbol of an element
+	int high;//high 16 bits of the usage count of an element
+	int low;//low 16 bits of the usage count of an element
+
+	if(input == 0){
+		fprintf(stderr, "LZW: Could not open file\n");
+		exit(1);
+	}
+	if(fscanf(input,"LZWK%d:%c:%ld:%ld:%ld:%d:%ld:%d:%d:%d:%ld:%ld",
+				&version,&found,&k->maxBits,&k->prune,&k->options,&n,
+				&k->numBits,&k->curr,&k->hand,&k->low,&k->inBytes,
+				&k->outBytes) != 12
+		|| getc(input) != '\n' || version != CHECKPOINT_VERSION
+		|| found != role || !optionsValid(k->maxBits,k->prune,k->options)
+		|| k->numBits < INITIAL_BITS || k->numBits > MAX_MAX_BITS
+		|| k->low < EMPTY || k->low > UCHAR_MAX){
+		fprintf(stderr, "LZW: Checkpoint corrupt\n");
+		exit(1);
+	}
+	k->role = role;
+	symbolsSet(k->options);
+	if(n < afterLiterals || n > (1 << k->maxBits) || k->curr < 0
+		|| k->curr > n || k->hand < 0 || k->hand >= (1 << k->maxBits)){
+		fprintf(stderr, "LZW: Checkpoint corrupt\n");
+		exit(1);
+	}
+	if((*filter = filtersCreate(k->options)) != 0
+		&& !FilterLoad(*filter,input)){
+		fprintf(stderr, "LZW: Checkpoint corrupt\n");
+		exit(1);
+	}
+	tablesCreate(k->maxBits,0,t,tarr);
+	for(int i=afterLiterals;i<n;i++){
+		prefix = fgetBits(MAX_MAX_BITS,input);
+		c = symbolRead(input);
+		high = fgetBits(16,input);
+		low = fgetBits(16,input);
+		if(prefix == EOF || c == EOF || high == EOF || low == EOF
+			|| prefix < 2 || prefix >= n){
+			fprintf(stderr, "LZW: Checkpoint corrupt\n");
+			exit(1);
+		}
+		TableInsert(t,i,prefix,c,k->maxBits,(high << 16) | low);
+		TableLinearInsert(tarr,i,prefix,c,k->maxBits,i);
+		(*tarr)->table[i]->usagecount = (high << 16) | low;
+	}
+	fclose(input);
+}
+
+void encodeCheckpoint(char *name, struct encoder *s, struct checkpoint *k,
+						long inBytes, long outBase){
+	k->role = 'E';
+	k->numBits = s->numBits;
+	k->curr = s->curr;
+	k->hand = (s->ev != 0) ? s->ev->hand : 0;
+	k->low = s->low;
+	k->inBytes = inBytes;
+	if(k->options & OPT_ENTROPY){
+		k->outBytes = outBase + HuffWritten();
+	} else{
+		k->outBytes = outBase + bitsWritten / CHAR_BIT;
+	}
+	checkpointWrite(name,k,s->tarr,s->filter);
+}
+
+Filter filtersCreate(long options){
+	if((options & OPT_FILTERS) == 0){
+		return 0;
+	}
+	return FilterCreate((options & OPT_FILTERS) >> OPT_FILTER_SHIFT);
+}
+
+void encoderCreate(struct encoder *s, long maxBits, char *in, long prune,
+					long options){
+	symbolsSet(options);
+	tablesCreate(maxBits,in,&s->t,&s->tarr);
+	s->filter = filtersCreate(options);
+	encoderSetup(s,maxBits,prune,options);
+}
+
+void encoderSetup(struct encoder *s, long maxBits, long prune, long options){
+	s->numBits = codeWidth(s->t->n);
+	encoderReset(s);
+	s->curr = s->t->n;
+	s->ev = 0;
+	s->frozen = 0;
+	s->low = EMPTY;
+	s->cache = calloc(1 << CACHE_BITS,sizeof(uint64_t));
+	s->jumps = calloc(1 << JUMP_BITS,sizeof(struct jump));
+	s->plain = 0;
+	if(options & OPT_EVICT){
+		s->ev = evictCreate(maxBits,s->tarr);
+	} else if(prune == 0 && s->t->n == (1 << maxBits)){
+		//in-table already fills the table
+		s->frozen = trieFreeze(s->tarr);
+	}
+}
+
+void encoderDestroy(struct encoder *s){
+	evictDestroy(s->ev);
+	trieThaw(s->frozen,s->tarr);
+	FilterDestroy(s->filter);
+	free(s->cache);
+	free(s->jumps);
+	tablesDestroy(s->t,s->tarr);
+}
+
+void encoderReset(struct encoder *s){
+	s->C = EMPTY;
+	s->anchor = EMPTY;
+	s->steps = 0;
+}
+
+void encoderFinish(struct encoder *s, long options){
+	int pad;//number of bits to the last byte
+
+	if(s->low != EMPTY){
+		//odd byte of a wide stream, ahead of the final code so that
+		//decode reads the flag at the width of a code
+		writeCode(options,s->numBits,ODD_FLAG);
+		writeCode(options,CHAR_BIT,s->low);
+	}
+	//at the very end if we read a value that was in table, still print it
+	if(s->C != EMPTY){
+		writeCode(options,s->numBits,s->C);
+	}
+	//print the remaining bits still in table, padding them to a whole
+	//byte as flushBits would but leaving putBits with none
+	if(options & OPT_ENTROPY){
+		HuffFlush();
+	} else if((pad = (CHAR_BIT - bitsWritten % CHAR_BIT) % CHAR_BIT) != 0){
+		putBits(pad,0);
+	}
+}
+
+int encoderStep(struct encoder *s, int K, long maxBits, long prune,
+					long options){
+	int index;//code of the string matched so far followed by K
+	int victim;//code reused by eviction
+
+	if(afterLiterals == AFTER_WIDE){
+		//wide symbols are two bytes, low byte first
+		if(s->low == EMPTY){
+			s->low = K;
+			return 1;
+		}
+		K = s->low | (K << CHAR_BIT);
+		s->low = EMPTY;
+	}
+	if(s->frozen != 0){
+		//table is full and never pruned so no usage counts are needed
+		index = TrieGet(s->frozen,s->C,K);
+		if(index == EMPTY){
+			writeCode(options,s->numBits,s->C);
+			s->C = TrieGet(s->frozen,EMPTY,K);
+			return 0;
+		}
+		s->C = index;
 		return 1;
 	}
-	free(program);
+	cacheLookups++;
+	if((index = cacheGet(s->cache,s->C,K)) == EMPTY){
+		index = TableGet(s->t,s->C,K);
+		if(index != EMPTY){
+			cachePut(s->cache,s->C,K,index);
+		}
+	} else{
+		cacheHits++;
+	}
+	if(index != EMPTY){
+		//element already in table
+		//increment usage count of sequence in array table, the count
+		//pruning and eviction go by (the hashtable's count is never read)
+		if((s->tarr->table[index]->usagecount)++ == 0){
+			tablesCounted(s->tarr,index);
+		}
+		s->C = index;
+		return 1;
+	}
+	//element not yet in table
+	//print element
+	writeCode(options,s->numBits,s->C);
+	if((s->ev != 0) && (s->t->n == (1 << maxBits))){
+		//table full so reuse the code of a cold element
+		victim = evictCode(s->ev,s->tarr,maxBits,s->C);
+		if(victim != EMPTY){
+			cacheForget(s->cache,s->tarr->table[victim]->prefix,
+						s->tarr->table[victim]->c);
+		}
+		evictInsert(s->ev,&s->t,s->tarr,victim,s->C,K,maxBits);
+	} else if(s->ev != 0){
+		(s->ev->children[s->C])++;
+	}
+	//insert element into table
+	TableInsert(&s->t,s->t->n,s->C,K,maxBits,0);
+	TableLinearInsert(&s->tarr,s->tarr->n,s->C,K,maxBits,s->curr);
+	//decode widens at the same point since it knows the table size
+	if(s->t->n > (1 << s->numBits)){
+		s->numBits++;
+	}
+	//if we can still insert, increment index to insert into
+	if(s->t->n < (1 << maxBits)){
+		s->curr++;
+	}
+	//if table has reached max size and it's time to prune
+	if(s->t->size == (1 << maxBits) && s->t->n == (1 << maxBits)
+		&& (prune != 0)){
+		//decode prunes at the same point since it knows the table size
+		//prune the table and update the number of bits
+		if(pruneTable(maxBits,prune,&s->tarr,&s->t,INITIAL_BITS,
+						options & OPT_HOT) == -1){
+			//there was an error detected when pruning
+			encoderDestroy(s);
+			exit(1);
+			return 0;
+		}
+		//the strings kept have new codes
+		memset(s->cache,0,sizeof(uint64_t) << CACHE_BITS);
+		memset(s->jumps,0,sizeof(struct jump) << JUMP_BITS);
+		s->numBits = codeWidth(s->t->n);
+		s->curr = s->t->n;
+	} else if(s->t->n == (1 << maxBits) && prune == 0 && s->ev == 0){
+		//table will never change again
+		s->frozen = trieFreeze(s->tarr);
+	}
+	s->C = TableGet(s->t,EMPTY,K);
 	return 0;
 }
 
-int pruneTable(long maxBits, long prune, Table *tarr, Table *t, int initSize){
-	Table tnew = TableCreate(1 << initSize);//new hashtable
-	Table tarrnew = TableCreate(1 << initSize);//new array version of table
-	int endSize = initSize;//number of bits needed at end
-
-	//array whose indices are old codes and values are corresponding new codes
-	//used to determine the new prefix of elements when inserting
-	int *newCodes = malloc(sizeof(int) * (*t)->n);
-	for(int i=0;i<(*t)->n;i++){
-		newCodes[i] = -1;
-	}
+void encoderRun(struct encoder *s, unsigned char *data, long n,
+				long maxBits, long prune, long options){
+	long i = 0;//next byte of data
+	int to;//code a jump leads to
+	int code;//code a jump passes through
+	struct elt *e;//element of code
+	struct jump *j;//slot of a jump from anchor
+	long jumped = 0;//bytes of data skipped by jumps
 
-	//initialize our table with ASCII values
-	for(int i=2;i<AFTER_ASCII;i++){
-		TableInsert(&tnew,i,EMPTY,i-2,maxBits,0);
-		TableLinearInsert(&tarrnew,i,EMPTY,i-2,maxBits,i);
-		newCodes[i] = i;
+	//jumps are byte strings, which a wide string need not line up with
+	if(afterLiterals == AFTER_WIDE || s->plain > 0){
+		for(;i<n;i++){
+			encoderStep(s,data[i],maxBits,prune,options);
+		}
+		if(s->plain > 0){
+			s->plain--;
+		}
+		//the string matched so far is as long as any, so start counting
+		s->anchor = EMPTY;
+		s->steps = 0;
+		return;
 	}
-
-	int curr = AFTER_ASCII;//current index being inserted in array
-	for(int i=AFTER_ASCII;i<(*tarr)->n;i++){
-		//if values usage count is above prune, insert it into new table
-		if(((*tarr)->table[i] != 0) && (*tarr)->table[i]->usagecount >= prune){
-			//record oldcode-newcode association
-			newCodes[(*tarr)->table[i]->code] = tnew->n;
-			//somehow the prefix hasn't been associated
-			if(newCodes[(*tarr)->table[i]->prefix] == -1){
-				fprintf(stderr, "LZW: Table Corrupt\n");
-				return -1;
+	while(i < n){
+		if(s->steps == 0 && s->anchor != EMPTY && n - i >= JUMP_BYTES
+			&& (to = jumpGet(s,data + i)) != EMPTY){
+			if(s->frozen == 0){
+				//count each code passed through, as encoderStep would
+				code = to;
+				for(int k=0;k<JUMP_BYTES;k++){
+					e = s->tarr->table[code];
+					if((e->usagecount)++ == 0){
+						tablesCounted(s->tarr,code);
+					}
+					code = e->prefix;
+				}
 			}
-			//insert the element into the table and the array version of the table
-			if(TableInsert(&tnew,tnew->n,newCodes[(*tarr)->table[i]->prefix],
-							(*tarr)->table[i]->c,maxBits,0)){
-				endSize++;
+			s->C = to;
+			s->anchor = to;
+			i += JUMP_BYTES;
+			jumped += JUMP_BYTES;
+			continue;
+		}
+		if(!encoderStep(s,data[i],maxBits,prune,options)){
+			//a string starts with data[i]
+			s->anchor = EMPTY;
+			s->steps = 0;
+			i++;
+			continue;
+		}
+		if(s->anchor == EMPTY){
+			//not yet long enough for jumps to pay
+			if(++(s->steps) == JUMP_BYTES){
+				s->anchor = s->C;
+				s->steps = 0;
 			}
-			TableLinearInsert(&tarrnew,tarrnew->n,
-							newCodes[(*tarr)->table[i]->prefix],
-							(*tarr)->table[i]->c,maxBits,curr);
-			curr++;
+			i++;
+			continue;
 		}
+		s->path[s->steps++] = data[i++];
+		if(s->steps == JUMP_BYTES){
+			//the next time anchor is matched, try these bytes first
+			j = &s->jumps[s->anchor & ((1 << JUMP_BITS) - 1)];
+			memcpy(&j->bytes,s->path,JUMP_BYTES);
+			j->from = s->anchor;
+			j->to = s->C;
+			s->anchor = s->C;
+			s->steps = 0;
+		}
+	}
+	jumpedBytes += jumped;
+	if(jumped * JUMP_SHARE < n){
+		s->plain = JUMP_BACKOFF;
 	}
+}
 
-	//make t and tarr point to the new tables
-	TableDestroy((*t));
-	TableDestroy((*tarr));
-	free(newCodes);
-	(*t) = tnew;
-	(*tarr) = tarrnew;
+int jumpGet(struct encoder *s, unsigned char *data){
+	struct jump *j = &s->jumps[s->anchor & ((1 << JUMP_BITS) - 1)];
+	uint64_t bytes;//next JUMP_BYTES bytes of input
+	int code;//code the jump passes through
 
-	//if we exactly filled up the table
-	if((*t)->n == (1 << (endSize))){
-		endSize++;
+	if(j->from != s->anchor){
+		return EMPTY;
 	}
-	return endSize;
+	memcpy(&bytes,data,JUMP_BYTES);
+	if(bytes != j->bytes){
+		return EMPTY;
+	}
+	//eviction may have given a code on the way to another string since,
+	//so check the prefixes of to still spell the bytes back to from
+	code = j->to;
+	for(int k=JUMP_BYTES-1;k>=0;k--){
+		if(code == EMPTY || s->tarr->table[code]->c != data[k]){
+			return EMPTY;
+		}
+		code = s->tarr->table[code]->prefix;
+	}
+	return (code == j->from) ? j->to : EMPTY;
 }
 
-void encode(long maxBits, char *out, char *in, long prune){
-	//send the correct flags to decode
-	if(in == 0){
-		printf("%ld:%ld:%ld:%s\n",maxBits,prune,(unsigned long) 0,"");
-	} else{
-		printf("%ld:%ld:%ld:%s\n",maxBits,prune,strlen(in),in);
+/*
+ * A slot holds code << 40 | prefix << 16 | K, which fits as codes and
+ * prefixes are below 1 << MAX_MAX_BITS and K below WIDE_TOTAL. 0 is an
+ * empty slot since no prefix is below 2. Growing the hashtable moves its
+ * elements but keeps their codes, so only pruning and eviction, which
+ * change codes, make slots stale.
+ */
+static unsigned long cacheSlot(uint64_t key){
+	return (key * UINT64_C(0x9E3779B97F4A7C15)) >> (64 - CACHE_BITS);
+}
+
+int cacheGet(uint64_t *cache, int prefix, int K){
+	uint64_t key = ((uint64_t) prefix << 16) | K;//pair looked up
+	uint64_t slot;//contents of the slot of key
+
+	if(prefix == EMPTY){
+		//literals are looked up only once a code has been written
+		return EMPTY;
+	}
+	slot = cache[cacheSlot(key)];
+	if((slot & ((UINT64_C(1) << 40) - 1)) != key){
+		return EMPTY;
 	}
-	int start=2;//need 0 and 1 to tell decode to increase numBits and prune
-	int tableSize = 1 << INITIAL_BITS;//size of table
-	long numBits = INITIAL_BITS;//current number of bits printed
-	Table t = TableCreate(tableSize);//create table
-	Table tarr = TableCreate(tableSize);//create array table
+	return slot >> 40;
+}
 
-	//initialize table with ASCII values
-	for(int i=start;i<(start+ASCII_TOTAL);i++){
-		if(TableInsert(&t,i,EMPTY,i-start,maxBits,0)==1){
-			numBits++;
-		}
-		TableLinearInsert(&tarr,i,EMPTY,i-start,maxBits,i);
+void cachePut(uint64_t *cache, int prefix, int K, int code){
+	uint64_t key = ((uint64_t) prefix << 16) | K;//pair put
+
+	if(prefix != EMPTY){
+		cache[cacheSlot(key)] = ((uint64_t) code << 40) | key;
 	}
+}
 
-	int inP;//prefix read in in-table
-	char inC;//character read in in-table
-	int inTableRead;//current read from in-table
+void cacheForget(uint64_t *cache, int prefix, int K){
+	if(cacheGet(cache,prefix,K) != EMPTY){
+		cache[cacheSlot(((uint64_t) prefix << 16) | K)] = 0;
+	}
+}
 
-	if(in != 0){
-		FILE *input = fopen(in,"r");
-		//read in table from in to get the start value
-		if(input){
-			while((inTableRead = fgetc(input)) != EOF){
-				if(inTableRead != ':'){
-					//did not fit style of table that I used
-					fprintf(stderr, "LZW: In-Table Corrupt\n");
-					TableDestroy(t);
-					TableDestroy(tarr);
-					exit(1);
-					fclose(input);
-					return;
-				}
-				inP = fgetBits(MAX_MAX_BITS,input);
-				inC = fgetc(input);
-				if((inP < (tarr->size)) && tarr->table[inP] == 0){
-					//somehow prefix not in table yet
-					fprintf(stderr, "LZW: In-Table Corrupt\n");
-					TableDestroy(t);
-					TableDestroy(tarr);
-					exit(1);
-					fclose(input);
-					return;
-				}
-				//insert values into table
-				if(TableInsert(&t,t->n,inP,inC,maxBits,0)==1){
-					numBits++;
-				}
-				TableLinearInsert(&tarr,tarr->n,inP,inC,maxBits,tarr->n);
-			}
-			fclose(input);
-		} else{
-			//file not opened for whatever reason
-			fprintf(stderr, "LZW: Could not open file\n");
-			TableDestroy(t);
-			TableDestroy(tarr);
-			exit(1);
-			return;
+void cacheReport(void){
+	fprintf(stderr,"LZW: pair cache answered %ld of %ld lookups (%.1f%%)\n",
+			cacheHits,cacheLookups,
+			(cacheLookups == 0) ? 0.0 : 100.0 * cacheHits / cacheLookups);
+	fprintf(stderr,"LZW: jumps skipped %ld bytes\n",jumpedBytes);
+}
+
+void encode(long maxBits, char *out, char *in, long prune, long options,
+			long syncBytes, long idle, char *keep, char *resume){
+	struct encoder s;//state of the stream
+	long sinceSync = 0;//bytes read since the last sync-flush
+	struct sigaction request;//makes SIGUSR1 ask for a sync-flush
+	struct checkpoint k;//state saved by keep or restored from resume
+	long inBytes;//bytes of input used since the stream started
+	long outBase;//bytes of the stream before this run's codes
+	unsigned char *data;//bytes of input read
+	long n;//number of bytes in data
+	long room;//most bytes to read before the next sync-flush is due
+	unsigned char filtered[FILTER_ROOM(BUFSIZ)];//data after the filters
+
+	if(resume != 0){
+		//carry on from where encode -k left off, without a header
+		checkpointRead(resume,'E',&k,&s.t,&s.tarr,&s.filter);
+		maxBits = k.maxBits;
+		prune = k.prune;
+		options = k.options;
+		encoderSetup(&s,maxBits,prune,options);
+		s.numBits = k.numBits;
+		s.curr = k.curr;
+		s.low = k.low;
+		if(s.ev != 0){
+			s.ev->hand = k.hand;
 		}
+		inBytes = k.inBytes;
+		outBase = k.outBytes;
+	} else{
+		k.maxBits = maxBits;
+		k.prune = prune;
+		k.options = options;
+		inBytes = 0;
+		outBase = encodeHeader(maxBits,in,prune,options);
+		encoderCreate(&s,maxBits,in,prune,options);
 	}
-	int C = EMPTY;//prefix of newly read character
-	int K;//newly read character
-	int index = EMPTY;//index to insert element into table
-	struct elt *e;//element to be inserted into table
-	int curr = t->n;//current index for arrayTable
+	//no SA_RESTART so that a request interrupts waiting for input
+	memset(&request,0,sizeof(request));
+	request.sa_handler = syncRequest;
+	sigaction(SIGUSR1,&request,0);
 
-	while((K = getchar()) != EOF){
-		index = TableGet(t,C,K);
-		if(index != EMPTY){
-			//element already in table
-			//increment usage count of sequence in array table
-		    if((tarr->table[index]->prefix == C) 
-		    	&& (tarr->table[index]->c == K)){
-		    	(tarr->table[index]->usagecount)++;
-		    }
-			//increment usage count of sequence in hashtable
-			for(e = t->table[HASH(C,K,t->size)]; e != 0; e = e->next){
-		        if((e->prefix == C) && (e->c == K)){
-		            (e->usagecount)++;
-		            break;
-		        }
-		    }
-			C = index;
-		} else{
-			//element not yet in table
-			//print element
-			putBits(numBits,C);
-			//insert element into table
-			if(TableInsert(&t,t->n,C,K,maxBits,0)==1){
-				putBits(numBits,BIT_FLAG);
-				numBits++;
-			}
-			TableLinearInsert(&tarr,tarr->n,C,K,maxBits,curr);
-			//if we can still insert, increment index to insert into
-			if(t->n < (1 << maxBits)){
-				curr++;
-			}
-			//if table has reached max size and it's time to prune
-			if(t->size == (1 << maxBits) && t->n == (1 << maxBits) 
-				&& (prune != 0)){
-				//send code to tell decode to prune
-				putBits(numBits,PRUNE_FLAG);
-				//prune the table and update the number of bits
-				numBits = pruneTable(maxBits,prune,&tarr,&t,INITIAL_BITS);
-				//there was an error detected when pruning
-				if(numBits == -1){
-					TableDestroy(t);
-					TableDestroy(tarr);
-					exit(1);
-					return;
+	for(;;){
+		room = BUFSIZ;
+		if(syncBytes > 0 && syncBytes - sinceSync < room){
+			room = syncBytes - sinceSync;
+		}
+		if((n = readInput(idle,room,&data)) == EOF){
+			break;
+		}
+		if(n == SYNC){
+			//input idle or sync-flush requested
+			syncRequested = 0;
+			if(sinceSync != 0){
+				if(s.filter != 0){
+					//the count of a run waits for the run to end
+					encoderRun(&s,filtered,FilterEnd(s.filter,filtered),
+								maxBits,prune,options);
+				}
+				syncFlush(options,s.numBits,s.C);
+				encoderReset(&s);
+				sinceSync = 0;
+				if(keep != 0){
+					encodeCheckpoint(keep,&s,&k,inBytes,outBase);
 				}
-				curr = t->n;
 			}
-			C = TableGet(t,EMPTY,K);
+			continue;
 		}
+		inBytes += n;
+		if((sinceSync += n) == syncBytes){
+			//flush once these bytes have been matched
+			syncRequested = 1;
+		}
+		if(s.filter != 0){
+			n = FilterEncode(s.filter,data,n,filtered);
+			data = filtered;
+		}
+		encoderRun(&s,data,n,maxBits,prune,options);
 	}
-	//at the very end if we read a value that was in table, still print it
-	if(C != EMPTY){
-		putBits(numBits,C);
+	if(s.filter != 0){
+		encoderRun(&s,filtered,FilterEnd(s.filter,filtered),maxBits,prune,
+					options);
+	}
+	if(keep != 0){
+		//leave the stream at a sync-flush so that it can be carried on
+		syncFlush(options,s.numBits,s.C);
+		encoderReset(&s);
+		encodeCheckpoint(keep,&s,&k,inBytes,outBase);
+	} else{
+		encoderFinish(&s,options);
 	}
-	//print the remaining bits still in table
-	flushBits();	
 	if(out != 0){
 		FILE *output = fopen(out,"w");
 		//print table
 		if(output){
-			for(int i=start+ASCII_TOTAL;i<tarr->n;i++){
-				//To check for corruption and to check when we're done
-				fputc(':',output);
-				fputBits(MAX_MAX_BITS,tarr->table[i]->prefix,output);
-				fputc(tarr->table[i]->c,output);
-			}
+			writeTable(output,s.tarr);
 			fclose(output);
 		} else{
 			//out table not openable
 			fprintf(stderr, "LZW: Could not open file\n");
-			TableDestroy(t);
-			TableDestroy(tarr);
+			encoderDestroy(&s);
 			exit(1);
 			return;
 		}
 	}
-	TableDestroy(t);
-	TableDestroy(tarr);
+	encoderDestroy(&s);
+}
+
+Trie trieFreeze(Table tarr){
+	int *prefix;//prefix of each code
+	int *c;//last character of each code
+	Trie frozen;//trie of the table
+
+	if(lentTables != 0 && lentTables->tarr == tarr
+		&& lentTables->trie != 0){
+		//lent full, so the table has not changed since the trie was built
+		return lentTables->trie;
+	}
+	prefix = malloc(sizeof(int) * tarr->n);
+	c = malloc(sizeof(int) * tarr->n);
+	for(int i=AFTER_ASCII-ASCII_TOTAL;i<tarr->n;i++){
+		prefix[i] = tarr->table[i]->prefix;
+		c[i] = tarr->table[i]->c;
+	}
+	frozen = TrieCreate(tarr->n,prefix,c,afterLiterals - 2);
+	free(prefix);
+	free(c);
+	return frozen;
+}
+
+void trieThaw(Trie frozen, Table tarr){
+	if(lentTables == 0 || lentTables->tarr != tarr
+		|| lentTables->trie != frozen){
+		TrieDestroy(frozen);
+	}
 }
 
 void decodePrint(struct elt **arrayTable, int C){
@@ -417,192 +2368,371 @@ void decodePrint(struct elt **arrayTable, int C){
 	if(e->prefix != EMPTY){
 		//recursively print prefix then character
 		decodePrint(arrayTable,e->prefix);
-		printf("%c", (char) e->c);
+		decodeSymbol(e->c,afterLiterals == AFTER_WIDE);
 	} else{
 		//earliest character so just print it
-		printf("%c", (char) e->c);
+		decodeSymbol(e->c,afterLiterals == AFTER_WIDE);
 	}
 }
 
-void decode(char *out){
-	long maxBits;//max number of bits allowed
-	long prune;//usagecount lower bound for pruning
-	long inSize;//size of name of in-table file
+void decodeSymbol(int c, int wide){
+	if(outFilter == 0){
+		putchar(c & UCHAR_MAX);
+		if(wide){
+			putchar(c >> CHAR_BIT);
+		}
+		decodedBytes += wide ? 2 : 1;
+		return;
+	}
+	if(outLen + 2 > BUFSIZ){
+		decodeFlush();
+	}
+	outBuffer[outLen++] = c & UCHAR_MAX;
+	if(wide){
+		outBuffer[outLen++] = c >> CHAR_BIT;
+	}
+}
 
-	//read in maxBits, prune, and input table name
-	if(scanf("%ld:%ld:%ld:",&maxBits,&prune,&inSize) != 3){
-		//not all values read in correctly
-		fprintf(stderr, "LZW: Stream corrupted\n");
+void decodeFlush(void){
+	if(outFilter != 0){
+		decodedBytes += FilterDecode(outFilter,outBuffer,outLen,
+										filterOutput);
+		outLen = 0;
+	}
+}
+
+void testCreate(long maxBits){
+	sums = calloc(1 << maxBits,sizeof(struct sum));
+	for(int i=2;i<afterLiterals;i++){
+		if(afterLiterals == AFTER_WIDE){
+			//low byte then high byte, as symbolWrite prints them
+			sums[i].length = 2;
+			sums[i].hash = ((i - 2) & UCHAR_MAX) * SUM_BASE
+						+ ((i - 2) >> CHAR_BIT);
+			sums[i].power = SUM_BASE * SUM_BASE;
+		} else{
+			sums[i].length = 1;
+			sums[i].hash = i - 2;
+			sums[i].power = SUM_BASE;
+		}
+	}
+	testLength = 0;
+	testHash = 0;
+}
+
+void testSum(struct elt **arrayTable, int C){
+	int p = arrayTable[C]->prefix;//code of the prefix
+	int c = arrayTable[C]->c;//last symbol
+
+	if(sums[p].length == 0){
+		testSum(arrayTable,p);
+	}
+	if(afterLiterals == AFTER_WIDE){
+		sums[C].length = sums[p].length + 2;
+		sums[C].hash = (sums[p].hash * SUM_BASE + (c & UCHAR_MAX)) * SUM_BASE
+						+ (c >> CHAR_BIT);
+		sums[C].power = sums[p].power * SUM_BASE * SUM_BASE;
+	} else{
+		sums[C].length = sums[p].length + 1;
+		sums[C].hash = sums[p].hash * SUM_BASE + c;
+		sums[C].power = sums[p].power * SUM_BASE;
+	}
+}
+
+void testPrint(struct elt **arrayTable, int C){
+	if(sums[C].length == 0){
+		testSum(arrayTable,C);
+	}
+	testHash = testHash * sums[C].power + sums[C].hash;
+	testLength += sums[C].length;
+}
+
+void testByte(int b){
+	testHash = testHash * SUM_BASE + b;
+	testLength++;
+}
+
+ssize_t testWrite(void *cookie, const char *buf, size_t size){
+	for(size_t i=0;i<size;i++){
+		testByte((unsigned char) buf[i]);
+	}
+	return size;
+}
+
+void decodeCount(Table tarr, int C){
+	struct elt *e;//element whose usagecount is incremented
+	while(C != EMPTY){
+		//increment usagecounts of element and all prefixes of element
+		e = tarr->table[C];
+		if((e->usagecount)++ == 0){
+			tablesCounted(tarr,C);
+		}
+		C = e->prefix;
+	}
+}
+
+void decodeGrow(Table tarr, int curr){
+	while(curr >= tarr->size){
+		tarr->size *= 2;
+		tarr->table = realloc(tarr->table,
+						sizeof(*tarr->table)*(tarr->size));
+		for(int i=(tarr->size)/2;i<tarr->size;i++){
+			tarr->table[i] = 0;
+		}
+	}
+}
+
+long decodePrune(long maxBits, long prune, Table *tarr, Table *t, int oldC,
+					long options){
+	//count the last code, whose usage encode saw before pruning
+	decodeCount(*tarr,oldC);
+	long numBits = pruneTable(maxBits,prune,tarr,t,INITIAL_BITS,
+								options & OPT_HOT);
+	if(numBits == -1){
+		//error found in pruneTable
+		TableDestroy(*t);
+		TableDestroy(*tarr);
 		exit(1);
-		return;
+	}
+	if(sums != 0){
+		//the codes kept have new numbers
+		memset(sums + afterLiterals,0,
+				sizeof(struct sum) * ((1 << maxBits) - afterLiterals));
+	}
+	//resize tables if needed
+	decodeGrow(*tarr,(*t)->n);
+	return numBits;
+}
+
+long decodeHeader(long *version, long *maxBits, long *prune, long *options,
+					char **in){
+	long inSize;//size of name of in-table file
+	int first;//first character of stream, used to tell version
+	int n = -1;//bytes read by scanf
+	long bytes;//bytes of the header read
+
+	//read in version, maxBits, prune, and input table name
+	if((first = getchar()) == 'V'){
+		if(scanf("%ld:%ld:%ld:%ld:%ld:%n",version,maxBits,prune,
+					options,&inSize,&n) != 5 || n < 0){
+			//not all values read in correctly
+			fprintf(stderr, "LZW: Stream corrupted\n");
+			exit(1);
+		}
+		if(*version < 2 || *version > STREAM_VERSION
+			|| (*options & ~OPT_ALL)
+			|| !FilterValid((*options & OPT_FILTERS) >> OPT_FILTER_SHIFT)){
+			//stream written by a newer or unknown encode
+			fprintf(stderr, "LZW: Unsupported stream version\n");
+			exit(1);
+		}
+		bytes = 1 + n;
+	} else{
+		ungetc(first,stdin);
+		if(scanf("%ld:%ld:%ld:%n",maxBits,prune,&inSize,&n) != 3
+			|| n < 0){
+			//not all values read in correctly
+			fprintf(stderr, "LZW: Stream corrupted\n");
+			exit(1);
+		}
+		bytes = n;
 	}
 	if(inSize < 0){
 		//not all values read in correctly
 		fprintf(stderr, "LZW: Invalid inSize, Stream corrupted\n");
 		exit(1);
-		return;
 	}
-
-	char *in = 0;//name of file for in-table
+	if(!optionsValid(*maxBits,*prune,*options)){
+		//encode never writes these, and the tables could not hold them
+		fprintf(stderr, "LZW: Stream corrupted\n");
+		exit(1);
+	}
 	char c;//used to read and ensure format is maintained
 	if(inSize == 0){
-		in = 0;
+		*in = 0;
 	} else{
-		in = malloc(sizeof(char)*(inSize+1));
+		*in = malloc(sizeof(char)*(inSize+1));
 		for(int i=0;i<inSize;i++){
-			in[i] = getchar();
+			(*in)[i] = getchar();
 		}
-		in[inSize] = '\0';
+		(*in)[inSize] = '\0';
 	}
 	if((c = getchar())!='\n'){
 		//did not fit style of table that I used
 		fprintf(stderr, "LZW: Stream corrupted\n");
-		if(in != 0){
-			free(in);
-		}
 		exit(1);
-		return;
 	}
+	return bytes + inSize + 1;
+}
 
-	long numBits = INITIAL_BITS;//number of bits to print out
-	int arraySize = 1 << INITIAL_BITS;//size of tables
-	Table t = TableCreate(arraySize);
-	Table tarr = TableCreate(arraySize);
+void decodeCheckpoint(char *name, struct checkpoint *k, Table tarr,
+						long numBits, int curr, struct evict *ev,
+						long inBase, long outBytes){
+	k->role = 'D';
+	k->numBits = numBits;
+	k->curr = curr;
+	k->hand = (ev != 0) ? ev->hand : 0;
+	k->low = EMPTY;
+	if(k->options & OPT_ENTROPY){
+		k->inBytes = inBase + HuffRead();
+	} else{
+		k->inBytes = inBase + bitsRead / CHAR_BIT;
+	}
+	k->outBytes = outBytes;
+	checkpointWrite(name,k,tarr,outFilter);
+}
 
-	int start=2;//0 and 1 reserved to tell decode to increase numBits and prune
+void decode(char *out, char *keep, char *resume, int test){
+	long version = 1;//stream version (no "V" header means version 1)
+	long maxBits;//max number of bits allowed
+	long prune;//usagecount lower bound for pruning
+	long options = 0;//stream options of version 2 header
+	char *in = 0;//name of file for in-table
+	struct checkpoint k;//state saved by keep or restored from resume
+	long inBase;//bytes of the stream before this run's codes
+	long numBits;//number of bits to print out
+	Table t;//hashtable
+	Table tarr;//array table
 
-	//initialize table with ascii values
-	for(int i=start;i<(start+ASCII_TOTAL);i++){
-		TableLinearInsert(&tarr,i,EMPTY,i-start,maxBits,i);
-		if(TableInsert(&t,i,EMPTY,i-start,maxBits,0)==1){
-			numBits++;
+	if(resume != 0){
+		//carry on reading the stream where decode -k left off
+		checkpointRead(resume,'D',&k,&t,&tarr,&outFilter);
+		version = 2;
+		maxBits = k.maxBits;
+		prune = k.prune;
+		options = k.options;
+		inBase = k.inBytes;
+		decodedBytes = k.outBytes;
+		numBits = k.numBits;
+	} else{
+		inBase = decodeHeader(&version,&maxBits,&prune,&options,&in);
+		if((options & OPT_WIDE) && ((1 << maxBits) <= AFTER_WIDE)){
+			//codes too narrow for the wide literals
+			fprintf(stderr, "LZW: Stream corrupted\n");
+			exit(1);
 		}
-	}
-
-	int inP;//prefix read from in-table
-	char inC;//character read from in-table
-	int inTableRead;//current read from in-table
-	if(in != 0){
-		FILE *input = fopen(in,"r");
-		//read in table from in to get the start value
-		if(input){
-			while((inTableRead = fgetc(input)) != EOF){
-				if(inTableRead != ':'){
-					//did not fit style of table that I used
-					fprintf(stderr, "LZW: In-Table Corrupt\n");
-					free(in);
-					TableDestroy(t);
-					TableDestroy(tarr);
-					exit(1);
-					return;
-					fclose(input);
-				}
-				inP = fgetBits(MAX_MAX_BITS,input);
-				inC = fgetc(input);
-				if((inP < (tarr->size)) && tarr->table[inP] == 0){
-					//somehow prefix is not already in the table
-					//must be corrupt
-					fprintf(stderr, "LZW: In-Table Corrupt\n");
-					TableDestroy(t);
-					TableDestroy(tarr);
-					exit(1);
-					fclose(input);
-					return;
-				}
-				TableInsert(&t,t->n,inP,inC,maxBits,0);
-				if(TableLinearInsert(&tarr,tarr->n,inP,inC,maxBits,tarr->n)){
-					numBits++;
-				}
-			}
-			fclose(input);
-		} else{
-			//file not openable
-			fprintf(stderr, "LZW: Could not open file\n");
-			free(in);
-			TableDestroy(t);
-			TableDestroy(tarr);
+		if((version == 1) && (keep != 0)){
+			//version 1 streams have no sync-flush to stop at
+			fprintf(stderr, "LZW: -k needs a version 2 stream\n");
 			exit(1);
-			return;
 		}
+		k.maxBits = maxBits;
+		k.prune = prune;
+		k.options = options;
+		symbolsSet(options);
+		tablesCreate(maxBits,in,&t,&tarr);
 		free(in);
+		outFilter = filtersCreate(options);
+		//version 1 streams start as wide as the array table has grown
+		numBits = (version >= 2) ? codeWidth(t->n) : codeWidth(tarr->size);
+	}
+	bulkStart(options);
+	filterOutput = stdout;
+	if(test){
+		cookie_io_functions_t sums = {0,testWrite,0,0};//see testWrite
+		testCreate(maxBits);
+		filterOutput = fopencookie(0,"w",sums);
 	}
+
 	int oldC = EMPTY;//previous code
 	int newC;//current code
 	int C;//current code - changed when tracing stack
 	int curr = t->n;//current index in array
-	struct elt *e;//element to be inserted
-	int currC;//previous code - changed when tracing stack
-
-	while((newC = C = getBits(numBits)) != EOF){
-		if(C == 0){
-			//code says to prune
-			currC = oldC;
-			while(currC != EMPTY){
-				//increment usagecounts of previous element
-				//and all prefixes of element
-				for(e = t->table[HASH(tarr->table[currC]->prefix,
-									tarr->table[currC]->c,t->size)];
-									e != 0; e = e->next){
-			        if((e->prefix==tarr->table[currC]->prefix) 
-			        	&& (e->c==tarr->table[currC]->c)){
-			            (e->usagecount)++;
-			            break;
-			        }
-			    }
-				(tarr->table[currC]->usagecount)++;
-				currC = tarr->table[currC]->prefix;
+	long nE;//number of elements encode had when writing the next code
+	struct evict *ev = 0;//eviction state if evicting
+	int victim;//code reused for the new element once the table is full
+	int flushing = 0;//whether the code being read ends a sync-flush
+	int odd = EMPTY;//last byte of a wide stream of odd length
+	//whether usage counts are kept, as only pruning, eviction and
+	//checkpoints read them (version 1 streams may prune at any point)
+	int counting = (version == 1) || (prune != 0) || (options & OPT_EVICT)
+					|| (keep != 0);
+
+	if(options & OPT_EVICT){
+		ev = evictCreate(maxBits,tarr);
+	}
+	if(resume != 0){
+		curr = k.curr;
+		if(ev != 0){
+			ev->hand = k.hand;
+		}
+	}
+	//an in-table can leave the tables exactly full
+	decodeGrow(tarr,curr);
+	for(;;){
+		if(version >= 2){
+			//encode inserted the element that we insert after reading
+			//the next code before writing it, unless the table was full
+			nE = t->n;
+			if((oldC != EMPTY) && (nE < (1 << maxBits))){
+				nE++;
 			}
-			//prune table and 
-			numBits = pruneTable(maxBits,prune,&tarr,&t,INITIAL_BITS);
-			//error found in pruneTable
-			if(numBits == -1){
-				TableDestroy(t);
-				TableDestroy(tarr);
-				exit(1);
-				return;
+			while((1 << numBits) < nE){
+				numBits++;
 			}
-			//update current index and previous code
-			curr = t->n;
-			oldC = EMPTY;
-
-			//resize tables if needed
-			while(tarr->n >= tarr->size){
-				tarr->size *= 2;
-				tarr->table = realloc(tarr->table,
-						sizeof(*tarr->table)*(tarr->size));
-				for(int i=(tarr->size)/2;i<tarr->size;i++){
-					tarr->table[i] = 0;
-				}
+		}
+		if((newC = C = readCode(options,numBits)) == EOF){
+			break;
+		}
+		if(version == 1){
+			if(C == PRUNE_FLAG){
+				//code says to prune
+				numBits = decodePrune(maxBits,prune,&tarr,&t,oldC,options);
+				//update current index and previous code
+				curr = t->n;
+				oldC = EMPTY;
+				continue;
 			}
-			while(t->n >= t->size){
-				t->size *= 2;
-				t->table = realloc(t->table,sizeof(*t->table)*(t->size));
-				for(int i=(t->size)/2;i<t->size;i++){
-					t->table[i] = 0;
-				}
+			if(C == BIT_FLAG){
+				//code says to increment bits
+				numBits++;
+				continue;
 			}
+		}
+		if(C == FLUSH_FLAG){
+			//next code is the last before a sync-flush
+			flushing = 1;
 			continue;
 		}
-		if(C == 1){
-			//code says to increment bits
-			numBits++;
+		if((C == ODD_FLAG) && (options & OPT_WIDE) && (odd == EMPTY)){
+			//last byte of the input, printed after the final code
+			if((odd = readCode(options,CHAR_BIT)) == EOF){
+				fprintf(stderr, "LZW: Byte Stream corrupt\n");
+				exit(1);
+			}
 			continue;
 		}
-		if((C < 0) || (C > curr)){
-			//code not legal and thus corrupt
+		if((C < 2) || (C > curr) || ((C == curr)
+			&& ((oldC == EMPTY) || (t->n >= (1 << maxBits))))){
+			//code not legal and thus corrupt (only the code about to be
+			//added may be used before it is, and none is with a full table)
 			fprintf(stderr, "LZW: Byte Stream corrupt\n");
 			TableDestroy(t);
 			TableDestroy(tarr);
 			exit(1);
 			return;
 		}
-		//if(tarr->table[C]==0){
-			//KwKwK
-			//assert(curr == tarr->n);
-			//assert(C==curr);
-			//assert(oldC != EMPTY);
-		//}
-		if(oldC != EMPTY){
+		if((oldC != EMPTY) && (ev != 0) && (t->n == (1 << maxBits))){
+			//table full so reuse the code encode chose, which may be C
+			decodeCount(tarr,oldC);
+			victim = evictCode(ev,tarr,maxBits,oldC);
+			if(victim != EMPTY){
+				if(C == victim){
+					//KwKwK, so C starts with the same character as oldC
+					C = oldC;
+				}
+				while(tarr->table[C]->prefix != EMPTY){
+					C = tarr->table[C]->prefix;
+				}
+				evictInsert(ev,&t,tarr,victim,oldC,tarr->table[C]->c,maxBits);
+				if(test){
+					sums[victim].length = 0;
+				}
+			}
+		} else if(oldC != EMPTY){
+			if(ev != 0){
+				(ev->children[oldC])++;
+			}
 			if(t->n < (1 << maxBits)){
 				//table not full so we should insert into arrayTable
 				tarr->table[curr] = malloc(sizeof(struct elt));
@@ -610,20 +2740,14 @@ void decode(char *out){
 				tarr->table[curr]->usagecount = 0;
 				tarr->table[curr]->next = 0;
 				tarr->table[curr]->prefix = oldC;
+				if(test){
+					sums[curr].length = 0;
+				}
 			}
-			//update usagecounts
-			currC = oldC;
-			while(currC != EMPTY){
-				for(e = t->table[HASH(tarr->table[currC]->prefix,
-					tarr->table[currC]->c,t->size)]; e != 0; e = e->next){
-			        if((e->prefix==tarr->table[currC]->prefix) 
-			        	&& (e->c==tarr->table[currC]->c)){
-			            (e->usagecount)++;
-			            break;
-			        }
-			    }
-				(tarr->table[currC]->usagecount)++;
-				currC = tarr->table[currC]->prefix;
+			//update usagecounts, which a frozen table no longer needs
+			if(counting && ((version == 1) || (prune != 0)
+							|| (t->n < (1 << maxBits)))){
+				decodeCount(tarr,oldC);
 			}
 			if(t->n < (1 << maxBits)){
 				//table not full so we should insert into table
@@ -637,35 +2761,68 @@ void decode(char *out){
 				curr++;
 			}
 			//increase size of tables if needed
-			while(curr >= tarr->size){
-				tarr->size *= 2;
-				tarr->table = realloc(tarr->table,
-								sizeof(*tarr->table)*(tarr->size));
-				for(int i=(tarr->size)/2;i<tarr->size;i++){
-					tarr->table[i] = 0;
-				}
+			decodeGrow(tarr,curr);
+		}
+		if(test && (outFilter == 0)){
+			testPrint(tarr->table,newC);
+		} else{
+			decodePrint(tarr->table,newC);
+		}
+		oldC = newC;
+		if(flushing){
+			//encode added nothing after this code and counted its use
+			if(counting){
+				decodeCount(tarr,oldC);
 			}
-			while(curr >= t->size){
-				t->size *= 2;
-				t->table = realloc(t->table,sizeof(*t->table)*(t->size));
-				for(int i=(t->size)/2;i<t->size;i++){
-					t->table[i] = 0;
-				}
+			oldC = EMPTY;
+			flushing = 0;
+			syncAlign(options);
+			decodeFlush();
+			fflush(stdout);
+			if(keep != 0){
+				decodeCheckpoint(keep,&k,tarr,numBits,curr,ev,inBase,
+									decodedBytes);
 			}
+		} else if((version >= 2) && (prune != 0)
+					&& (t->n + 1 >= (1 << maxBits))){
+			//encode filled its table after writing this code and pruned
+			decodePrune(maxBits,prune,&tarr,&t,oldC,options);
+			numBits = codeWidth(t->n);
+			curr = t->n;
+			oldC = EMPTY;
 		}
-		decodePrint(tarr->table,newC);
-		oldC = newC;
+	}
+	if(odd != EMPTY && test && (outFilter == 0)){
+		testByte(odd);
+	} else if(odd != EMPTY){
+		decodeSymbol(odd,0);
+	}
+	decodeFlush();
+	if((outFilter != 0) && (keep == 0) && !FilterDone(outFilter)){
+		//the stream ends between a run and its count
+		fprintf(stderr, "LZW: Byte Stream corrupt\n");
+		exit(1);
+	}
+	if(keep != 0){
+		if((oldC != EMPTY) || (odd != EMPTY)){
+			//the stream was ended rather than cut by encode -k
+			fprintf(stderr, "LZW: Stream does not end at a checkpoint\n");
+			exit(1);
+		}
+		decodeCheckpoint(keep,&k,tarr,numBits,curr,ev,inBase,decodedBytes);
+	}
+	if(test){
+		//the filters may still hold output for testWrite
+		fclose(filterOutput);
+		printf("%ld %016llx\n",testLength,(unsigned long long) testHash);
+		free(sums);
+		sums = 0;
 	}
 	if(out != 0){
 		FILE *output = fopen(out,"w");
 		//print table
 		if(output){
-			for(int i=AFTER_ASCII;i<tarr->n;i++){
-				//To check for corruption and to check when we're done
-				fputc(':',output);
-				fputBits(MAX_MAX_BITS,tarr->table[i]->prefix,output);
-				fputc(tarr->table[i]->c,output);
-			}
+			writeTable(output,tarr);
 			fclose(output);
 		} else{
 			//file not openable
@@ -676,6 +2833,8 @@ void decode(char *out){
 			return;
 		}
 	}
-	TableDestroy(t);
-	TableDestroy(tarr);
-}
\ No newline at end of file
+	evictDestroy(ev);
+	FilterDestroy(outFilter);
+	outFilter = 0;
+	tablesDestroy(t,tarr);
+}
\ No newline at end of file
@@ -0,0 +1,436 @@
+/*
+ * Archive mode: many files in one container.
+ * Members listed together (up to a blank line in the list) form a group
+ * whose contents are encoded as one stream, so later members are coded
+ * with the dictionary learned from earlier ones. Each group is a complete
+ * encode stream and groups are independent, so they are handled by up to
+ * jobs worker processes at once (encode and decode keep their bit I/O
+ * state in static variables, which rules out threads).
+ *
+ * Format: "LZWA1:members:groups\n", then for each member
+ * "group:length:nameLength:name\n", then for each group
+ * "streamLength\n" followed by the stream written by encode.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "./lzwArchive.h"
+
+#define ARCHIVE_VERSION (1)
+
+//encode and decode from lzw.c, run by the workers on each group
+void encode(long maxBits, char *out, char *in, long prune, long options,
+            long syncBytes, long idle, char *keep, char *resume);
+void decode(char *out, char *keep, char *resume, int test);
+
+//File stored in an archive
+struct member{
+    char *name;//path of the file
+    long length;//number of bytes in the file
+    int group;//group the file is encoded in
+};
+
+//Files of an archive in the order they are stored
+struct archive{
+    int n;//number of members
+    int size;//number of members there is space for
+    int groups;//number of groups
+    struct member *members;//members, ordered by group
+};
+
+/*
+ * Add a member to the archive
+ */
+static void archiveAdd(struct archive *a, char *name, long length, int group){
+    if(a->n == a->size){
+        a->size = (a->size == 0) ? 16 : a->size * 2;
+        a->members = realloc(a->members,sizeof(struct member) * a->size);
+    }
+    a->members[a->n].name = name;
+    a->members[a->n].length = length;
+    a->members[a->n].group = group;
+    (a->n)++;
+}
+
+/*
+ * Free memory in the archive
+ */
+static void archiveFree(struct archive *a){
+    for(int i=0;i<a->n;i++){
+        free(a->members[i].name);
+    }
+    free(a->members);
+}
+
+/*
+ * Copy up to n bytes from one file to another (all of them if n < 0)
+ * and return the number copied
+ */
+static long copyBytes(FILE *from, FILE *to, long n){
+    char buffer[BUFSIZ];
+    long copied = 0;
+    size_t want;
+    size_t got;
+
+    while(n < 0 || copied < n){
+        want = (n < 0 || n - copied > BUFSIZ) ? BUFSIZ : (size_t) (n - copied);
+        if((got = fread(buffer,1,want,from)) == 0){
+            break;
+        }
+        fwrite(buffer,1,got,to);
+        copied += got;
+    }
+    return copied;
+}
+
+/*
+ * Wait for the worker pid (any worker if pid is -1) to finish;
+ * returns 0 if it succeeded and -1 if not
+ */
+static int waitWorker(pid_t pid){
+    int status;
+
+    if(waitpid(pid,&status,0) == -1 || !WIFEXITED(status)
+        || WEXITSTATUS(status) != 0){
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Returns whether a member name stays below the current directory
+ */
+static int safeName(const char *name){
+    const char *p = name;
+
+    if(name[0] == '\0' || name[0] == '/'){
+        return 0;
+    }
+    while(p != 0){
+        if(strncmp(p,"..",2) == 0 && (p[2] == '/' || p[2] == '\0')){
+            return 0;
+        }
+        p = strchr(p,'/');
+        if(p != 0){
+            p++;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Create the directories leading up to a member
+ */
+static void makeParents(char *name){
+    for(char *p = strchr(name,'/'); p != 0; p = strchr(p + 1,'/')){
+        *p = '\0';
+        mkdir(name,0777);
+        *p = '/';
+    }
+}
+
+/*
+ * Worker encoding group g of the archive to out; does not return
+ */
+static void encodeGroup(struct archive *a, int g, FILE *out, long maxBits,
+                        char *in, long prune, long options){
+    FILE *cat = tmpfile();//contents of the members of the group
+    FILE *f;
+
+    if(cat == 0){
+        fprintf(stderr, "LZW: Could not create temporary file\n");
+        exit(1);
+    }
+    for(int i=0;i<a->n;i++){
+        if(a->members[i].group != g){
+            continue;
+        }
+        f = fopen(a->members[i].name,"rb");
+        if(f == 0 || copyBytes(f,cat,-1) != a->members[i].length){
+            //file changed or vanished since it was listed
+            fprintf(stderr, "LZW: Could not read %s\n",a->members[i].name);
+            exit(1);
+        }
+        fclose(f);
+    }
+    rewind(cat);
+    dup2(fileno(cat),STDIN_FILENO);
+    dup2(fileno(out),STDOUT_FILENO);
+    clearerr(stdin);
+    encode(maxBits,0,in,prune,options,0,0,0,0);
+    exit(0);
+}
+
+/*
+ * Worker decoding group g of the archive from stream
+ * and writing its members; does not return.
+ * If test is set, the group is only checked (see decode) and a line
+ * "group length hash" is written in place of its members.
+ */
+static void decodeGroup(struct archive *a, int g, FILE *stream, int test){
+    FILE *out = tmpfile();//decoded contents of the members of the group
+    FILE *f;
+    FILE *report = 0;//standard output, for the line written by a test
+    long length;//length of the group found by a test
+    long expected = 0;//total length of the members of the group
+    char hash[17];//hash of the group found by a test
+
+    if(out == 0){
+        fprintf(stderr, "LZW: Could not create temporary file\n");
+        exit(1);
+    }
+    //read the stream through stdin, dropping what stdin read ahead of the
+    //archive before the fork
+    dup2(fileno(stream),STDIN_FILENO);
+    fclose(stream);
+    rewind(stdin);
+    if(test){
+        report = fdopen(dup(STDOUT_FILENO),"w");
+    }
+    dup2(fileno(out),STDOUT_FILENO);
+    decode(0,0,0,test);
+    fflush(stdout);
+    rewind(out);
+    if(test){
+        for(int i=0;i<a->n;i++){
+            if(a->members[i].group == g){
+                expected += a->members[i].length;
+            }
+        }
+        if(fscanf(out,"%ld %16s",&length,hash) != 2 || length != expected){
+            fprintf(stderr, "LZW: Archive corrupt\n");
+            exit(1);
+        }
+        fprintf(report,"%d %ld %s\n",g,length,hash);
+        exit(0);
+    }
+    for(int i=0;i<a->n;i++){
+        if(a->members[i].group != g){
+            continue;
+        }
+        makeParents(a->members[i].name);
+        f = fopen(a->members[i].name,"wb");
+        if(f == 0){
+            fprintf(stderr, "LZW: Could not open %s\n",a->members[i].name);
+            exit(1);
+        }
+        if(copyBytes(out,f,a->members[i].length) != a->members[i].length){
+            fprintf(stderr, "LZW: Archive corrupt\n");
+            exit(1);
+        }
+        fclose(f);
+    }
+    if(getc(out) != EOF){
+        //more data than the members hold
+        fprintf(stderr, "LZW: Archive corrupt\n");
+        exit(1);
+    }
+    exit(0);
+}
+
+/*
+ * Wait for the worker encoding a group to stream and print the stream
+ * with its length, unless failed is set by an earlier group.
+ * Closes stream and returns -1 if this or an earlier group failed.
+ */
+static int printGroup(FILE *stream, pid_t worker, int failed){
+    failed |= waitWorker(worker);
+    if(!failed){
+        fseek(stream,0,SEEK_END);
+        printf("%ld\n",ftell(stream));
+        rewind(stream);
+        copyBytes(stream,stdout,-1);
+    }
+    fclose(stream);
+    return failed;
+}
+
+/*
+ * Write an archive of the files named in list to standard output.
+ * Takes in the name of the list of files (one per line, a blank line
+ * starting a new group), the number of groups encoded at once,
+ * and the arguments to encode each group with.
+ */
+void ArchiveEncode(char *list, long jobs, long maxBits, char *in,
+                    long prune, long options){
+    struct archive a = {0,0,0,0};
+    FILE *listFile = fopen(list,"r");
+    char *line = 0;//line read from list
+    size_t lineSize = 0;//space allocated for line
+    ssize_t len;//length of line
+    struct stat st;//used to find the length of each member
+    int grouped = 0;//number of members in the group being listed
+
+    if(listFile == 0){
+        fprintf(stderr, "LZW: Could not open file\n");
+        exit(1);
+    }
+    while((len = getline(&line,&lineSize,listFile)) != -1){
+        while(len > 0 && (line[len-1] == '\n' || line[len-1] == '\r')){
+            line[--len] = '\0';
+        }
+        if(len == 0){
+            //blank line ends the group
+            if(grouped != 0){
+                a.groups++;
+                grouped = 0;
+            }
+            continue;
+        }
+        if(stat(line,&st) != 0 || !S_ISREG(st.st_mode)){
+            fprintf(stderr, "LZW: Could not read %s\n",line);
+            exit(1);
+        }
+        archiveAdd(&a,strdup(line),st.st_size,a.groups);
+        grouped++;
+    }
+    if(grouped != 0){
+        a.groups++;
+    }
+    free(line);
+    fclose(listFile);
+
+    //print the index, then encode the groups with at most jobs workers
+    //running; the oldest group is printed and its temporary file closed
+    //before another worker starts, so no more than jobs files are open
+    printf("LZWA%d:%d:%d\n",ARCHIVE_VERSION,a.n,a.groups);
+    for(int i=0;i<a.n;i++){
+        printf("%d:%ld:%ld:%s\n",a.members[i].group,a.members[i].length,
+                (long) strlen(a.members[i].name),a.members[i].name);
+    }
+    FILE **streams = malloc(sizeof(FILE *) * (a.groups + 1));
+    pid_t *workers = malloc(sizeof(pid_t) * (a.groups + 1));
+    int printed = 0;//number of groups printed
+    int failed = 0;//whether a worker failed
+    for(int g=0;g<a.groups;g++){
+        if(g - printed == jobs){
+            failed = printGroup(streams[printed],workers[printed],failed);
+            printed++;
+        }
+        if((streams[g] = tmpfile()) == 0){
+            fprintf(stderr, "LZW: Could not create temporary file\n");
+            exit(1);
+        }
+        fflush(stdout);
+        if((workers[g] = fork()) == 0){
+            encodeGroup(&a,g,streams[g],maxBits,in,prune,options);
+        } else if(workers[g] == -1){
+            fprintf(stderr, "LZW: Could not start worker\n");
+            exit(1);
+        }
+    }
+    while(printed < a.groups){
+        failed = printGroup(streams[printed],workers[printed],failed);
+        printed++;
+    }
+    free(workers);
+    free(streams);
+    archiveFree(&a);
+    if(failed){
+        fprintf(stderr, "LZW: Could not encode archive\n");
+        exit(1);
+    }
+}
+
+/*
+ * Read an archive from standard input and write its members,
+ * decoding at most jobs groups at once, or only check its groups
+ * if test is set (see decodeGroup)
+ */
+void ArchiveDecode(long jobs, int test){
+    struct archive a = {0,0,0,0};
+    int version;//archive version
+    int n;//number of members
+    int group;//group of member being read
+    long length;//length of member being read
+    long nameSize;//length of name of member being read
+    char *name;//name of member being read
+
+    if(scanf("LZWA%d:%d:%d",&version,&n,&a.groups) != 3
+        || getchar() != '\n' || n < 0 || a.groups < 0){
+        fprintf(stderr, "LZW: Archive corrupt\n");
+        exit(1);
+    }
+    if(version != ARCHIVE_VERSION){
+        fprintf(stderr, "LZW: Unsupported archive version\n");
+        exit(1);
+    }
+    for(int i=0;i<n;i++){
+        if(scanf("%d:%ld:%ld:",&group,&length,&nameSize) != 3
+            || group < 0 || group >= a.groups || length < 0 || nameSize <= 0
+            || (i > 0 && group < a.members[i-1].group)){
+            fprintf(stderr, "LZW: Archive corrupt\n");
+            exit(1);
+        }
+        name = malloc(nameSize + 1);
+        if(fread(name,1,nameSize,stdin) != (size_t) nameSize
+            || getchar() != '\n'){
+            fprintf(stderr, "LZW: Archive corrupt\n");
+            exit(1);
+        }
+        name[nameSize] = '\0';
+        if(strlen(name) != (size_t) nameSize || !safeName(name)){
+            fprintf(stderr, "LZW: Unsafe member name %s\n",name);
+            exit(1);
+        }
+        archiveAdd(&a,name,length,group);
+    }
+
+    //copy the stream of each group to a temporary file of its own (gone
+    //once closed, however we exit) and hand it to a worker, keeping at most
+    //jobs running; the worker reads the file rather than our stdin, whose
+    //file offset it would share
+    int running = 0;//number of workers running
+    int failed = 0;//whether a worker failed
+    int corrupt = 0;//whether the streams of the groups were cut short
+    FILE *stream;//stream of the group being handed out
+    pid_t pid;
+    for(int g=0;g<a.groups;g++){
+        if(scanf("%ld",&length) != 1 || getchar() != '\n' || length < 0){
+            corrupt = 1;
+            break;
+        }
+        if((stream = tmpfile()) == 0){
+            fprintf(stderr, "LZW: Could not create temporary file\n");
+            exit(1);
+        }
+        if(copyBytes(stdin,stream,length) != length){
+            fclose(stream);
+            corrupt = 1;
+            break;
+        }
+        fflush(stream);
+        rewind(stream);
+        fflush(stdout);
+        if((pid = fork()) == 0){
+            decodeGroup(&a,g,stream,test);
+        } else if(pid == -1){
+            fprintf(stderr, "LZW: Could not start worker\n");
+            exit(1);
+        }
+        fclose(stream);
+        if(++running == jobs){
+            failed |= waitWorker(-1);
+            running--;
+        }
+    }
+    while(running > 0){
+        failed |= waitWorker(-1);
+        running--;
+    }
+    archiveFree(&a);
+    if(corrupt){
+        fprintf(stderr, "LZW: Archive corrupt\n");
+        exit(1);
+    }
+    if(failed){
+        fprintf(stderr, "LZW: Could not decode archive\n");
+        exit(1);
+    }
+}
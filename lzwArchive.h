@@ -0,0 +1,8 @@
+/*
+ * Archives of many files sharing dictionaries
+ */
+
+void ArchiveEncode(char *list, long jobs, long maxBits, char *in,
+                    long prune, long options);
+
+void ArchiveDecode(long jobs, int test);
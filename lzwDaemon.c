@@ -0,0 +1,473 @@
+/*
+ * lzwd: serves encode and decode requests on a Unix domain socket.
+ * The daemon builds the starting tables for every maxBits and in-table
+ * once, then forks jobs workers, each accepting requests on the socket
+ * and serving them one after another for as long as it lives. Requests
+ * pay for neither exec, nor argument parsing, nor reading the in-table,
+ * nor a fork. A worker that exits (encode and decode exit on corrupt
+ * input) is replaced. Only the user running lzwd can make requests, as
+ * they are served with its permissions.
+ *
+ * Request: "E:maxBits:prune:options:" followed by the name of the
+ * in-table and the working directory of the client, or "D:" followed by
+ * the working directory; each name is sent as "length:bytes", the two
+ * separated by ':' and ended by '\n'. The bytes to encode or decode follow
+ * until the client shuts down its side of the connection. In-tables and
+ * those named by streams are found from the working directory of the
+ * client, as they would be without lzwd.
+ * Reply: the output in chunks, each "length\n" followed by length bytes,
+ * as it is written, ended by "0\n", or by "ERR\n" if the request failed.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "./lzwDaemon.h"
+
+#define MIN_BITS (9)
+#define MAX_BITS (20)
+
+//from lzw.c
+void encode(long maxBits, char *out, char *in, long prune, long options,
+            long syncBytes, long idle, char *keep, char *resume);
+void decode(char *out, char *keep, char *resume, int test);
+int tablesPreload(long maxBits, char *in);
+int optionsValid(long maxBits, long prune, long options);
+void codecReset(void);
+
+static int client = -1;//connection of the request a worker serves
+static int replied = 0;//whether the worker has replied
+
+static pid_t *workers = 0;//process of each worker (0 for none yet)
+static long nWorkers = 0;//number of workers
+
+/*
+ * Write all n bytes of buffer to fd, returning whether it could
+ */
+static int writeAll(int fd, const char *buffer, size_t n){
+    ssize_t wrote;
+
+    while(n > 0){
+        if((wrote = write(fd,buffer,n)) == -1){
+            if(errno == EINTR){
+                continue;
+            }
+            return 0;
+        }
+        buffer += wrote;
+        n -= wrote;
+    }
+    return 1;
+}
+
+/*
+ * Reply with an error if the worker exits before replying,
+ * as encode and decode exit on corrupt input
+ */
+static void replyError(void){
+    if(!replied && client != -1){
+        replied = 1;
+        writeAll(client,"ERR\n",4);
+    }
+}
+
+/*
+ * Write function of the standard output of a worker, sending what
+ * encode and decode print to the client as a chunk
+ */
+static ssize_t replyWrite(void *cookie, const char *buf, size_t size){
+    char header[32];//length of the chunk
+    int n = sprintf(header,"%lu\n",(unsigned long) size);
+
+    if(!writeAll(client,header,n) || !writeAll(client,buf,size)){
+        return -1;
+    }
+    return size;
+}
+
+/*
+ * Return the next byte of the request on fd, or EOF if there is none;
+ * read a byte at a time as encode reads the rest without stdio
+ */
+static int requestByte(int fd){
+    unsigned char c;
+    ssize_t got;
+
+    while((got = read(fd,&c,1)) == -1 && errno == EINTR){
+    }
+    return (got == 1) ? c : EOF;
+}
+
+/*
+ * Read a number of the request on fd into value, returning the byte
+ * after it (EOF if there are no digits)
+ */
+static int requestNumber(int fd, long *value){
+    int c = requestByte(fd);
+    int digits = 0;//number of digits read
+
+    *value = 0;
+    while(c >= '0' && c <= '9' && *value < LONG_MAX / 10 - 10){
+        *value = *value * 10 + (c - '0');
+        digits++;
+        c = requestByte(fd);
+    }
+    return (digits == 0) ? EOF : c;
+}
+
+/*
+ * Read a name of the request on fd followed by the byte end,
+ * returning it (0 if the request is corrupt)
+ */
+static char *requestName(int fd, int end){
+    long length;//length of the name
+    char *name;
+
+    if(requestNumber(fd,&length) != ':' || length > PATH_MAX){
+        return 0;
+    }
+    name = malloc(length + 1);
+    for(long i=0;i<length;i++){
+        int c = requestByte(fd);
+        if(c == EOF){
+            free(name);
+            return 0;
+        }
+        name[i] = c;
+    }
+    name[length] = '\0';
+    if(requestByte(fd) != end){
+        free(name);
+        return 0;
+    }
+    return name;
+}
+
+/*
+ * Serve the request on connection conn, exiting if it is corrupt
+ */
+static void serve(int conn){
+    int op = requestByte(conn);//'E' or 'D'
+    long maxBits = 0;
+    long prune = 0;
+    long options = 0;
+    char *in = 0;//name of in-table
+    char *cwd;//working directory of the client
+
+    client = conn;
+    replied = 0;
+    if(op == 'E'){
+        if(requestByte(conn) != ':'
+            || requestNumber(conn,&maxBits) != ':'
+            || requestNumber(conn,&prune) != ':'
+            || requestNumber(conn,&options) != ':'
+            || !optionsValid(maxBits,prune,options)
+            || (in = requestName(conn,':')) == 0){
+            exit(1);
+        }
+    } else if(op != 'D' || requestByte(conn) != ':'){
+        exit(1);
+    }
+    if((cwd = requestName(conn,'\n')) == 0 || chdir(cwd) == -1){
+        exit(1);
+    }
+
+    //encode or decode the rest of the connection into it
+    dup2(conn,STDIN_FILENO);
+    if(op == 'E'){
+        encode(maxBits,0,(in[0] == '\0') ? 0 : in,prune,options,0,0,0,0);
+    } else{
+        decode(0,0,0,0);
+    }
+    fflush(stdout);
+    codecReset();
+    replied = writeAll(conn,"0\n",2);
+    free(in);
+    free(cwd);
+}
+
+/*
+ * Returns whether the client on connection conn runs as our user,
+ * as requests are served with our permissions
+ */
+static int sameUser(int conn){
+    struct ucred peer;//credentials of the client
+    socklen_t size = sizeof(peer);
+
+    return getsockopt(conn,SOL_SOCKET,SO_PEERCRED,&peer,&size) == 0
+            && peer.uid == geteuid();
+}
+
+/*
+ * Worker accepting requests on listener and serving them; does not return
+ */
+static void work(int listener){
+    cookie_io_functions_t reply = {0,replyWrite,0,0};//see replyWrite
+    int none = open("/dev/null",O_RDONLY);//standard input between requests
+    int conn;//connection of a request
+
+    atexit(replyError);
+    stdout = fopencookie(0,"w",reply);
+    if(stdout == 0 || none == -1){
+        exit(1);
+    }
+    for(;;){
+        if((conn = accept(listener,0,0)) == -1){
+            if(errno == EINTR){
+                continue;
+            }
+            exit(1);
+        }
+        if(!sameUser(conn)){
+            close(conn);
+            continue;
+        }
+        serve(conn);
+        client = -1;
+        dup2(none,STDIN_FILENO);
+        close(conn);
+    }
+}
+
+/*
+ * Stop the workers when the daemon is stopped by signal sig
+ */
+static void stopWorkers(int sig){
+    for(long i=0;i<nWorkers;i++){
+        if(workers[i] > 0){
+            kill(workers[i],SIGTERM);
+        }
+    }
+    signal(sig,SIG_DFL);
+    raise(sig);
+}
+
+/*
+ * Fill addr with the address of the socket named path
+ */
+static void socketAddress(struct sockaddr_un *addr, char *path){
+    if(strlen(path) >= sizeof(addr->sun_path)){
+        fprintf(stderr, "LZW: Socket name too long\n");
+        exit(1);
+    }
+    memset(addr,0,sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strcpy(addr->sun_path,path);
+}
+
+/*
+ * Serve requests on the socket named path with jobs workers.
+ * Tables are built ahead for every maxBits, with no in-table
+ * and with each of the nTables in-tables named in tables.
+ */
+void DaemonServe(char *path, long jobs, char **tables, int nTables){
+    struct sockaddr_un addr;
+    int listener;//socket requests arrive on
+    mode_t mask;//file mode creation mask of the daemon
+    pid_t pid;
+
+    for(long bits=MIN_BITS;bits<=MAX_BITS;bits++){
+        tablesPreload(bits,0);
+    }
+    for(int i=0;i<nTables;i++){
+        int fits = 0;//number of maxBits the in-table fits in
+        for(long bits=MIN_BITS;bits<=MAX_BITS;bits++){
+            fits += tablesPreload(bits,tables[i]);
+        }
+        if(fits == 0){
+            fprintf(stderr, "LZW: Could not use in-table %s\n",tables[i]);
+            exit(1);
+        }
+    }
+
+    //the socket is created with mode 0600 so that only our user can
+    //connect, and workers check that of each client as well
+    socketAddress(&addr,path);
+    unlink(path);
+    mask = umask(S_IRWXG | S_IRWXO);
+    if((listener = socket(AF_UNIX,SOCK_STREAM,0)) == -1
+        || bind(listener,(struct sockaddr *) &addr,sizeof(addr)) == -1
+        || listen(listener,SOMAXCONN) == -1){
+        fprintf(stderr, "LZW: Could not listen on %s\n",path);
+        exit(1);
+    }
+    umask(mask);
+    //a client going away only ends its request
+    signal(SIGPIPE,SIG_IGN);
+    workers = calloc(jobs,sizeof(pid_t));
+    nWorkers = jobs;
+    signal(SIGTERM,stopWorkers);
+    signal(SIGINT,stopWorkers);
+    signal(SIGHUP,stopWorkers);
+
+    for(;;){
+        //start the workers not running, then wait for one to exit
+        for(long i=0;i<nWorkers;i++){
+            if(workers[i] != 0){
+                continue;
+            }
+            fflush(stdout);
+            if((pid = fork()) == 0){
+                signal(SIGTERM,SIG_DFL);
+                signal(SIGINT,SIG_DFL);
+                signal(SIGHUP,SIG_DFL);
+                work(listener);
+            }
+            if(pid == -1){
+                fprintf(stderr, "LZW: Could not start worker\n");
+                stopWorkers(SIGTERM);
+            }
+            workers[i] = pid;
+        }
+        if((pid = wait(0)) > 0){
+            for(long i=0;i<nWorkers;i++){
+                if(workers[i] == pid){
+                    workers[i] = 0;
+                }
+            }
+        }
+    }
+}
+
+/*
+ * Write the chunks of the reply in buffer (got bytes) to standard output,
+ * returning 1 once the reply has ended, 0 if more is to come and -1 if
+ * the request failed
+ */
+static int replyRead(char *buffer, ssize_t got){
+    static char line[32];//length of the next chunk read so far
+    static int lineLength = 0;
+    static long left = 0;//bytes of the current chunk not yet read
+    long n;//bytes of the chunk in buffer
+
+    for(ssize_t i=0;i<got;){
+        if(left > 0){
+            n = (left < got - i) ? left : got - i;
+            fwrite(buffer + i,1,n,stdout);
+            left -= n;
+            i += n;
+        } else if(buffer[i] != '\n'){
+            if(lineLength == sizeof(line) - 1){
+                return -1;
+            }
+            line[lineLength++] = buffer[i++];
+        } else{
+            line[lineLength] = '\0';
+            lineLength = 0;
+            i++;
+            if(strcmp(line,"0") == 0){
+                return 1;
+            } else if((left = strtol(line,0,10)) <= 0){
+                //"ERR" or corrupt
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ * Client: send standard input to the daemon on the socket named path to
+ * be encoded (op 'E', with the arguments given) or decoded (op 'D'),
+ * and print the result to standard output
+ */
+void DaemonRequest(char *path, int op, long maxBits, long prune,
+                    long options, char *in){
+    struct sockaddr_un addr;
+    int conn;//connection to the daemon
+    char *data = malloc(BUFSIZ);//standard input
+    long size = BUFSIZ;//bytes data can hold
+    long length = 0;//bytes in data
+    long sent = 0;//bytes of data sent
+    size_t got;//bytes read
+    char cwd[PATH_MAX];//working directory, where in is found
+    char *header;//start of the request
+    char buffer[BUFSIZ];//reply read
+    struct pollfd p;//used to wait to send or receive
+    int ended = 0;//whether the reply has ended
+
+    //read all of the input before connecting so that a worker is not held
+    //waiting for input that may itself be the reply to another request
+    while((got = fread(data + length,1,size - length,stdin)) > 0){
+        length += got;
+        if(length == size){
+            size *= 2;
+            data = realloc(data,size);
+        }
+    }
+    if(getcwd(cwd,sizeof(cwd)) == 0){
+        fprintf(stderr, "LZW: Could not find working directory\n");
+        exit(1);
+    }
+    if(in == 0){
+        in = "";
+    }
+    header = malloc(strlen(in) + strlen(cwd) + 128);
+    if(op == 'E'){
+        sprintf(header,"E:%ld:%ld:%ld:%lu:%s:%lu:%s\n",maxBits,prune,options,
+                (unsigned long) strlen(in),in,(unsigned long) strlen(cwd),cwd);
+    } else{
+        sprintf(header,"D:%lu:%s\n",(unsigned long) strlen(cwd),cwd);
+    }
+
+    socketAddress(&addr,path);
+    if((conn = socket(AF_UNIX,SOCK_STREAM,0)) == -1
+        || connect(conn,(struct sockaddr *) &addr,sizeof(addr)) == -1){
+        fprintf(stderr, "LZW: Could not connect to %s\n",path);
+        exit(1);
+    }
+    signal(SIGPIPE,SIG_IGN);
+    if(!writeAll(conn,header,strlen(header))){
+        fprintf(stderr, "LZW: Request failed\n");
+        exit(1);
+    }
+    if(length == 0){
+        shutdown(conn,SHUT_WR);
+    }
+    free(header);
+
+    //the output comes back while the input is still being sent
+    fcntl(conn,F_SETFL,O_NONBLOCK);
+    while(!ended){
+        p.fd = conn;
+        p.events = (sent < length) ? (POLLIN | POLLOUT) : POLLIN;
+        if(poll(&p,1,-1) == -1){
+            if(errno == EINTR){
+                continue;
+            }
+            break;
+        }
+        if((sent < length) && (p.revents & POLLOUT)){
+            ssize_t wrote = write(conn,data + sent,length - sent);
+            if(wrote > 0 && (sent += wrote) == length){
+                shutdown(conn,SHUT_WR);
+            }
+        }
+        if(p.revents & (POLLIN | POLLHUP | POLLERR)){
+            ssize_t n = read(conn,buffer,sizeof(buffer));
+            if(n == -1 && (errno == EAGAIN || errno == EINTR)){
+                continue;
+            }
+            if(n <= 0 || (ended = replyRead(buffer,n)) == -1){
+                break;
+            }
+        }
+    }
+    if(ended != 1){
+        fprintf(stderr, "LZW: Request failed\n");
+        exit(1);
+    }
+    free(data);
+    close(conn);
+}
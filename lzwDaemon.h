@@ -0,0 +1,8 @@
+/*
+ * Compression daemon (lzwd) and its client
+ */
+
+void DaemonServe(char *path, long jobs, char **tables, int nTables);
+
+void DaemonRequest(char *path, int op, long maxBits, long prune,
+                    long options, char *in);
@@ -0,0 +1,317 @@
+/*
+ * Filters that turn input the dictionary learns slowly into fewer, more
+ * repetitive bytes: a delta stage, so that sorted numeric columns become
+ * runs of small differences, followed by a run-length stage, so that a
+ * long run of a byte costs three bytes per RLE_MAX instead of a new code
+ * for every few bytes.
+ * Both stages work a buffer at a time and keep their state between
+ * buffers, so a stream can be filtered as it arrives.
+ *
+ * Run-length: a byte that repeats the byte before it is followed by a
+ * count (0 to RLE_MAX) of further repeats, so "aaaaab" becomes "aa" 3 "b".
+ * After a count the next byte starts afresh, even if it is the same byte.
+ * Delta: each byte of a word becomes its difference from the same byte of
+ * the word before it, borrowing across the bytes of the word as in a
+ * subtraction of little-endian words.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include "./lzwFilter.h"
+
+#define EMPTY (-1)
+#define RLE_MAX (255)//most repeats given by one count
+#define WORD_BYTES (8)//bytes compared at once when scanning a run
+
+struct filter{
+    int filters;//FILTER_ flags in use
+    int width;//bytes in a word for the delta stage, 0 if none
+    unsigned char last[4];//previous word
+    unsigned char cur[4];//bytes of the word being filtered
+    int pos;//position in cur of the next byte
+    int borrow;//borrow (encode) or carry (decode) into that byte
+    int prev;//byte a run would repeat, EMPTY if none
+    int run;//repeats counted so far (encode) or 0 if the next byte is a
+            //count (decode), EMPTY if not in a run
+    unsigned char *scratch;//output of the delta stage for the run stage
+    size_t size;//size of scratch
+    unsigned char out[BUFSIZ];//output of decode not yet written
+    size_t nOut;//bytes in out
+};
+
+Filter FilterCreate(int filters){
+    Filter f = calloc(1,sizeof(struct filter));
+
+    assert(f != 0);
+    f->filters = filters;
+    if(filters & FILTER_DELTA1){
+        f->width = 1;
+    } else if(filters & FILTER_DELTA2){
+        f->width = 2;
+    } else if(filters & FILTER_DELTA4){
+        f->width = 4;
+    }
+    f->prev = EMPTY;
+    f->run = EMPTY;
+    return f;
+}
+
+/*
+ * Returns the FILTER_ flags of a comma-separated list of filter names
+ * (rle, delta, delta2, delta4), or -1 if a name is unknown or the list
+ * is not valid (see FilterValid)
+ */
+int FilterParse(char *names){
+    static char *known[] = {"rle","delta","delta2","delta4"};
+    int filters = 0;//flags of the names read
+    size_t len;//length of a name
+    int i;
+
+    for(;;){
+        len = strcspn(names,",");
+        for(i=0;i<4;i++){
+            if(strlen(known[i]) == len && strncmp(names,known[i],len) == 0){
+                break;
+            }
+        }
+        if(i == 4){
+            return -1;
+        }
+        filters |= 1 << i;
+        if(names[len] == '\0'){
+            break;
+        }
+        names += len + 1;
+    }
+    return FilterValid(filters) ? filters : -1;
+}
+
+/*
+ * Whether filters are FILTER_ flags that can be used together (at most
+ * one delta width)
+ */
+int FilterValid(int filters){
+    int deltas = filters & (FILTER_DELTA1 | FILTER_DELTA2 | FILTER_DELTA4);
+
+    return ((filters & ~FILTER_ALL) == 0) && ((deltas & (deltas - 1)) == 0);
+}
+
+/*
+ * Number of bytes at the start of p (at most max) equal to b, compared a
+ * word at a time
+ */
+static size_t runLength(unsigned char *p, size_t max, int b){
+    uint64_t pattern = UINT64_C(0x0101010101010101) * b;//b in every byte
+    uint64_t w;//bytes being compared
+    size_t len = 0;//bytes equal to b so far
+
+    while(len + WORD_BYTES <= max){
+        memcpy(&w,p + len,WORD_BYTES);
+        if(w != pattern){
+            break;
+        }
+        len += WORD_BYTES;
+    }
+    while(len < max && p[len] == b){
+        len++;
+    }
+    return len;
+}
+
+/*
+ * Filter the n bytes of in into out (which holds FILTER_ROOM(n) bytes),
+ * returning the number of bytes written. The count of a run still going
+ * at the end of in is written once the run ends.
+ */
+size_t FilterEncode(Filter f, unsigned char *in, size_t n,
+                    unsigned char *out){
+    unsigned char *p = in;//input of the run stage
+    size_t o = 0;//bytes written to out
+    size_t i = 0;//bytes of p used
+    size_t m;//length of a run
+    int d;//difference of a byte from the byte of the last word
+
+    if(f->width != 0){
+        //delta straight to out, or to scratch if the run stage follows
+        p = out;
+        if(f->filters & FILTER_RLE){
+            if(f->size < n){
+                f->size = n;
+                f->scratch = realloc(f->scratch,n);
+            }
+            p = f->scratch;
+        }
+        for(size_t j=0;j<n;j++){
+            d = in[j] - f->last[f->pos] - f->borrow;
+            f->borrow = d < 0;
+            p[j] = d & 0xFF;
+            f->cur[f->pos++] = in[j];
+            if(f->pos == f->width){
+                memcpy(f->last,f->cur,f->width);
+                f->pos = 0;
+                f->borrow = 0;
+            }
+        }
+        if(p == out){
+            return n;
+        }
+    } else if(!(f->filters & FILTER_RLE)){
+        memcpy(out,in,n);
+        return n;
+    }
+
+    if(f->run != EMPTY){
+        //carry on with the run the last buffer ended in
+        m = (size_t) (RLE_MAX - f->run);
+        m = runLength(p,(n < m) ? n : m,f->prev);
+        f->run += m;
+        i = m;
+        if(i == n && f->run < RLE_MAX){
+            return 0;
+        }
+        out[o++] = f->run;
+        f->run = EMPTY;
+        f->prev = EMPTY;
+    }
+    while(i < n){
+        out[o++] = p[i];
+        if(p[i++] != f->prev){
+            f->prev = p[i-1];
+            continue;
+        }
+        //second byte of a run, so the count follows
+        m = runLength(p + i,(n - i < RLE_MAX) ? n - i : RLE_MAX,f->prev);
+        i += m;
+        if(i == n && m < RLE_MAX){
+            f->run = m;
+            break;
+        }
+        out[o++] = m;
+        f->prev = EMPTY;
+    }
+    return o;
+}
+
+/*
+ * End the run filtered so far, if any, writing its count to out.
+ * Returns the number of bytes written (0 or 1).
+ */
+size_t FilterEnd(Filter f, unsigned char *out){
+    if(f->run == EMPTY){
+        return 0;
+    }
+    out[0] = f->run;
+    f->run = EMPTY;
+    f->prev = EMPTY;
+    return 1;
+}
+
+/*
+ * Undo the delta stage on byte b and add it to the output
+ */
+static void decodeByte(Filter f, int b, FILE *output){
+    if(f->width != 0){
+        b += f->last[f->pos] + f->borrow;
+        f->borrow = b > 0xFF;
+        b &= 0xFF;
+        f->cur[f->pos++] = b;
+        if(f->pos == f->width){
+            memcpy(f->last,f->cur,f->width);
+            f->pos = 0;
+            f->borrow = 0;
+        }
+    }
+    if(f->nOut == BUFSIZ){
+        fwrite(f->out,1,f->nOut,output);
+        f->nOut = 0;
+    }
+    f->out[f->nOut++] = b;
+}
+
+/*
+ * Undo the filters on the n bytes of in, writing the result to output.
+ * Returns the number of bytes written.
+ */
+long FilterDecode(Filter f, unsigned char *in, size_t n, FILE *output){
+    long written = 0;//bytes written
+
+    for(size_t i=0;i<n;i++){
+        if(!(f->filters & FILTER_RLE)){
+            decodeByte(f,in[i],output);
+            written++;
+        } else if(f->run != EMPTY){
+            //in[i] is the count of the run of f->prev
+            for(int j=0;j<in[i];j++){
+                decodeByte(f,f->prev,output);
+            }
+            written += in[i];
+            f->run = EMPTY;
+            f->prev = EMPTY;
+        } else{
+            decodeByte(f,in[i],output);
+            written++;
+            if(in[i] == f->prev){
+                f->run = 0;
+            } else{
+                f->prev = in[i];
+            }
+        }
+    }
+    fwrite(f->out,1,f->nOut,output);
+    f->nOut = 0;
+    return written;
+}
+
+/*
+ * Whether the bytes given to FilterDecode end where the filtered input
+ * could (not between a run and its count)
+ */
+int FilterDone(Filter f){
+    return f->run == EMPTY;
+}
+
+/*
+ * Write the state of f as a line of text to output
+ */
+void FilterSave(Filter f, FILE *output){
+    unsigned long last = 0;//bytes of last
+    unsigned long cur = 0;//bytes of cur
+
+    for(int i=3;i>=0;i--){
+        last = (last << 8) | f->last[i];
+        cur = (cur << 8) | f->cur[i];
+    }
+    fprintf(output,"%d:%d:%d:%d:%lu:%lu\n",f->prev,f->run,f->pos,f->borrow,
+            last,cur);
+}
+
+/*
+ * Read the state of f written by FilterSave from input.
+ * Returns 1 if the state was read and is valid, 0 otherwise.
+ */
+int FilterLoad(Filter f, FILE *input){
+    unsigned long last;//bytes of last
+    unsigned long cur;//bytes of cur
+
+    if(fscanf(input,"%d:%d:%d:%d:%lu:%lu",&f->prev,&f->run,&f->pos,
+                &f->borrow,&last,&cur) != 6 || getc(input) != '\n'
+        || f->prev < EMPTY || f->prev > 0xFF || f->run < EMPTY
+        || f->run > RLE_MAX || f->pos < 0 || f->borrow < 0 || f->borrow > 1
+        || (f->pos != 0 && f->pos >= f->width)){
+        return 0;
+    }
+    for(int i=0;i<4;i++){
+        f->last[i] = (last >> (8 * i)) & 0xFF;
+        f->cur[i] = (cur >> (8 * i)) & 0xFF;
+    }
+    return 1;
+}
+
+void FilterDestroy(Filter f){
+    if(f != 0){
+        free(f->scratch);
+        free(f);
+    }
+}
@@ -0,0 +1,36 @@
+/*
+ * Filters applied to the input of encode before the dictionary sees it
+ * and undone on the output of decode
+ */
+
+#define FILTER_RLE (1)//runs of a byte become two bytes and a count
+#define FILTER_DELTA1 (2)//bytes become their difference from the last byte
+#define FILTER_DELTA2 (4)//as FILTER_DELTA1 for 16-bit little-endian words
+#define FILTER_DELTA4 (8)//as FILTER_DELTA1 for 32-bit little-endian words
+#define FILTER_ALL (15)
+
+//Bytes FilterEncode may write for n bytes of input
+#define FILTER_ROOM(n) (2 * (n) + 1)
+
+typedef struct filter *Filter;
+
+Filter FilterCreate(int filters);
+
+int FilterParse(char *names);
+
+int FilterValid(int filters);
+
+size_t FilterEncode(Filter f, unsigned char *in, size_t n,
+                    unsigned char *out);
+
+size_t FilterEnd(Filter f, unsigned char *out);
+
+long FilterDecode(Filter f, unsigned char *in, size_t n, FILE *output);
+
+int FilterDone(Filter f);
+
+void FilterSave(Filter f, FILE *output);
+
+int FilterLoad(Filter f, FILE *input);
+
+void FilterDestroy(Filter f);
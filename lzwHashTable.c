@@ -179,4 +179,23 @@ int TableGet(Table t, int prefix, int c){
     }
 
     return -1;
+}
+
+/*
+ * Removes the element with given prefix and final character
+ * from the table given
+ */
+void TableDelete(Table t, int prefix, int c){
+    struct elt **prev;
+    struct elt *e;
+
+    for(prev = &t->table[HASH(prefix,c,t->size)]; (e = *prev) != 0;
+        prev = &e->next){
+        if(e->prefix==prefix && e->c==c){
+            *prev = e->next;
+            free(e);
+            (t->n)--;
+            return;
+        }
+    }
 }
\ No newline at end of file
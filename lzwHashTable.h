@@ -18,4 +18,6 @@ int TableLinearInsert(Table *t, int code, int prefix, int c, int maxBits, int in
 
 int TableInsert(Table *t, int code, int prefix, int c, int maxBits,int usage);
 
-int TableGet(Table t, int prefix, int c);
\ No newline at end of file
+int TableGet(Table t, int prefix, int c);
+
+void TableDelete(Table t, int prefix, int c);
\ No newline at end of file
@@ -0,0 +1,460 @@
+/*
+ * Entropy coding of the stream of LZW codes.
+ * Codes are buffered in blocks; each block is written with its own
+ * canonical Huffman code so that the code adapts to the data as it goes.
+ * A code below 256 is its own symbol, larger codes are split into a symbol
+ * holding their highest 5 bits and position, and raw extra bits.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "./lzwHuffman.h"
+
+#define HUFF_BLOCK (32768)//number of codes in a block
+#define HUFF_SYMBOLS (512)//number of symbols codes are split into
+#define HUFF_MAX_LEN (12)//longest Huffman code allowed
+#define COUNT_BITS (16)//bits used for the number of codes in a block
+#define LENGTH_BITS (4)//bits used for the length of each symbol's code
+#define SYMBOL_BITS (10)//bits used for the number of lengths sent
+#define OUT_BYTES (4096)//size of the buffer of bytes written
+#define PAYLOAD_BITS (24)//bits used for the number of bits of coded data
+
+static int block[HUFF_BLOCK];//codes waiting to be written
+static short symbols[HUFF_BLOCK];//symbol of each code in block
+static int nBlock = 0;//number of codes in block
+
+static unsigned long long outBits = 0;//bits not yet written
+static int nOut = 0;//number of bits in outBits
+static unsigned char outBytes[OUT_BYTES];//bytes not yet written
+static int nOutBytes = 0;//number of bytes in outBytes
+
+static unsigned long long inBits = 0;//bits read but not yet used
+static int nIn = 0;//number of bits in inBits
+static int remaining = 0;//codes left in the current block
+static long blockLeft = 0;//bits of coded data left in the current block
+static int done = 0;//whether the final block has been read
+
+static long bytesOut = 0;//bytes written to standard output
+static long bytesIn = 0;//bytes read from standard input
+
+//table indexed by the next HUFF_MAX_LEN bits giving the symbol and length
+static short lookSym[1 << HUFF_MAX_LEN];
+static unsigned char lookLen[1 << HUFF_MAX_LEN];
+
+/*
+ * Write the bytes in outBytes to standard output
+ */
+static void flushBytes(void){
+    fwrite(outBytes,1,nOutBytes,stdout);
+    bytesOut += nOutBytes;
+    nOutBytes = 0;
+}
+
+/*
+ * Write the low nBits (at most 32) bits of code, moving them to outBytes
+ * 32 at a time
+ */
+static void writeBits(int nBits, unsigned long code){
+    outBits = (outBits << nBits) | code;
+    nOut += nBits;
+    if(nOut >= 32){
+        nOut -= 32;
+        if(nOutBytes > OUT_BYTES - 4){
+            flushBytes();
+        }
+        outBytes[nOutBytes] = outBits >> (nOut + 24);
+        outBytes[nOutBytes+1] = outBits >> (nOut + 16);
+        outBytes[nOutBytes+2] = outBits >> (nOut + 8);
+        outBytes[nOutBytes+3] = outBits >> nOut;
+        nOutBytes += 4;
+    }
+}
+
+/*
+ * Write the bits not yet written, padded with zeros to a whole byte,
+ * and everything in outBytes to standard output
+ */
+static void padBytes(void){
+    flushBytes();
+    while(nOut >= 8){
+        nOut -= 8;
+        outBytes[nOutBytes++] = outBits >> nOut;
+    }
+    if(nOut != 0){
+        outBytes[nOutBytes++] = outBits << (8 - nOut);
+        nOut = 0;
+    }
+    flushBytes();
+}
+
+/*
+ * Return the next nBits bits from standard input; exits on end-of-file
+ * since a stream always ends with an empty block (or a sync-flush)
+ */
+static unsigned long readBits(int nBits){
+    int c;
+    unsigned long bits;
+
+    while(nIn < nBits){
+        if((c = getchar_unlocked()) == EOF){
+            fprintf(stderr, "LZW: Huffman Stream corrupt\n");
+            exit(1);
+        }
+        inBits = (inBits << 8) | c;
+        nIn += 8;
+        bytesIn++;
+    }
+    nIn -= nBits;
+    bits = (inBits >> nIn) & ((1UL << nBits) - 1);
+    return bits;
+}
+
+/*
+ * Return the symbol of code; a symbol s of 256 or more is followed by
+ * ((s - 256) >> 4) + 4 extra bits
+ */
+static int symbolOf(int code){
+    int p = 8;//position of highest bit of code
+
+    if(code < 256){
+        return code;
+    }
+    while((code >> (p + 1)) != 0){
+        p++;
+    }
+    return 256 + ((p - 8) << 4) + ((code >> (p - 4)) & 15);
+}
+
+/*
+ * Used by qsort to order symbols by frequency
+ */
+static const long *sortFreq;
+static int compareFreq(const void *a, const void *b){
+    long fa = sortFreq[*(const int *) a];
+    long fb = sortFreq[*(const int *) b];
+    return (fa > fb) - (fa < fb);
+}
+
+/*
+ * Fill len with Huffman code lengths for the frequencies in freq,
+ * halving the frequencies until no length exceeds HUFF_MAX_LEN
+ */
+static void huffLengths(long *freq, unsigned char *len){
+    int sym[HUFF_SYMBOLS];//symbols in use, by increasing frequency
+    long weight[2 * HUFF_SYMBOLS];//weights of leaves then internal nodes
+    int parent[2 * HUFF_SYMBOLS];//parent of each node
+    int depth[2 * HUFF_SYMBOLS];//depth of each node
+    int m = 0;//number of symbols in use
+    int maxLen;//longest length found
+
+    memset(len,0,HUFF_SYMBOLS);
+    for(int i=0;i<HUFF_SYMBOLS;i++){
+        if(freq[i] != 0){
+            sym[m++] = i;
+        }
+    }
+    if(m == 1){
+        len[sym[0]] = 1;
+    }
+    if(m <= 1){
+        return;
+    }
+    do{
+        sortFreq = freq;
+        qsort(sym,m,sizeof(int),compareFreq);
+        for(int i=0;i<m;i++){
+            weight[i] = freq[sym[i]];
+        }
+        //merge the two lightest of the sorted leaves and the internal nodes,
+        //which are created in order of weight
+        int leaf = 0;//next leaf to merge
+        int node = m;//next internal node to merge
+        for(int k=m;k<2*m-1;k++){
+            int pick[2];//the two nodes merged into k
+            for(int j=0;j<2;j++){
+                if(leaf < m && (node >= k || weight[leaf] <= weight[node])){
+                    pick[j] = leaf++;
+                } else{
+                    pick[j] = node++;
+                }
+            }
+            weight[k] = weight[pick[0]] + weight[pick[1]];
+            parent[pick[0]] = parent[pick[1]] = k;
+        }
+        depth[2*m-2] = 0;
+        maxLen = 0;
+        for(int k=2*m-3;k>=0;k--){
+            depth[k] = depth[parent[k]] + 1;
+            if(k < m){
+                len[sym[k]] = depth[k];
+                if(depth[k] > maxLen){
+                    maxLen = depth[k];
+                }
+            }
+        }
+        if(maxLen > HUFF_MAX_LEN){
+            //flatten the distribution and try again
+            for(int i=0;i<m;i++){
+                freq[sym[i]] = (freq[sym[i]] >> 1) | 1;
+            }
+        }
+    } while(maxLen > HUFF_MAX_LEN);
+}
+
+/*
+ * Fill codes with the canonical Huffman codes for the lengths in len
+ */
+static void huffCodes(const unsigned char *len, unsigned *codes){
+    int count[HUFF_MAX_LEN + 1] = {0};//number of codes of each length
+    unsigned next[HUFF_MAX_LEN + 1];//next code of each length
+    unsigned code = 0;
+
+    for(int i=0;i<HUFF_SYMBOLS;i++){
+        count[len[i]]++;
+    }
+    count[0] = 0;
+    for(int l=1;l<=HUFF_MAX_LEN;l++){
+        code = (code + count[l-1]) << 1;
+        next[l] = code;
+    }
+    for(int i=0;i<HUFF_SYMBOLS;i++){
+        if(len[i] != 0){
+            codes[i] = next[len[i]]++;
+        }
+    }
+}
+
+/*
+ * Write the codes in block with a Huffman code built for them
+ */
+static void writeBlock(void){
+    long freq[HUFF_SYMBOLS] = {0};//number of times each symbol is used
+    unsigned char len[HUFF_SYMBOLS];//length of each symbol's code
+    unsigned codes[HUFF_SYMBOLS];//code of each symbol
+    int nExtra[HUFF_SYMBOLS];//number of extra bits after each symbol
+    int nLen = 0;//number of lengths written
+    long payload = 0;//number of bits of coded data in the block
+
+    for(int i=0;i<nBlock;i++){
+        symbols[i] = symbolOf(block[i]);
+        freq[symbols[i]]++;
+    }
+    for(int i=0;i<HUFF_SYMBOLS;i++){
+        nExtra[i] = (i < 256) ? 0 : ((i - 256) >> 4) + 4;
+    }
+    huffLengths(freq,len);
+    huffCodes(len,codes);
+    for(int i=0;i<nBlock;i++){
+        payload += len[symbols[i]] + nExtra[symbols[i]];
+    }
+    for(int i=0;i<HUFF_SYMBOLS;i++){
+        if(len[i] != 0){
+            nLen = i + 1;
+        }
+    }
+    writeBits(COUNT_BITS,nBlock);
+    writeBits(SYMBOL_BITS,nLen);
+    for(int i=0;i<nLen;i++){
+        writeBits(LENGTH_BITS,len[i]);
+    }
+    //lets decode stop reading at the end of a block written by HuffSync
+    writeBits(PAYLOAD_BITS,payload);
+    for(int i=0;i<nBlock;i++){
+        //a symbol's code and its extra bits fit in one write
+        int s = symbols[i];
+        writeBits(len[s] + nExtra[s], ((unsigned long) codes[s] << nExtra[s])
+                    | (block[i] & ((1 << nExtra[s]) - 1)));
+    }
+    nBlock = 0;
+}
+
+/*
+ * Read the header of the next block and build its lookup table
+ */
+static void readBlock(void){
+    unsigned char len[HUFF_SYMBOLS] = {0};//length of each symbol's code
+    unsigned codes[HUFF_SYMBOLS];//code of each symbol
+    int nLen;//number of lengths sent
+    long space = 0;//share of the code space used, to check the lengths
+    int c;
+
+    if(nIn == 0){
+        if((c = getchar()) == EOF){
+            //a stream cut after a sync-flush (encode -k) ends here
+            done = 1;
+            return;
+        }
+        ungetc(c,stdin);
+    }
+    remaining = readBits(COUNT_BITS);
+    if(remaining == 0){
+        done = 1;
+        return;
+    }
+    nLen = readBits(SYMBOL_BITS);
+    if(nLen > HUFF_SYMBOLS){
+        fprintf(stderr, "LZW: Huffman Stream corrupt\n");
+        exit(1);
+    }
+    for(int i=0;i<nLen;i++){
+        len[i] = readBits(LENGTH_BITS);
+        if(len[i] > HUFF_MAX_LEN){
+            fprintf(stderr, "LZW: Huffman Stream corrupt\n");
+            exit(1);
+        }
+        if(len[i] != 0){
+            space += 1L << (HUFF_MAX_LEN - len[i]);
+        }
+    }
+    blockLeft = readBits(PAYLOAD_BITS);
+    if(space == 0 || space > (1L << HUFF_MAX_LEN)){
+        //lengths do not form a prefix code
+        fprintf(stderr, "LZW: Huffman Stream corrupt\n");
+        exit(1);
+    }
+    huffCodes(len,codes);
+    memset(lookLen,0,sizeof(lookLen));
+    for(int i=0;i<nLen;i++){
+        if(len[i] != 0){
+            int first = codes[i] << (HUFF_MAX_LEN - len[i]);
+            int last = (codes[i] + 1) << (HUFF_MAX_LEN - len[i]);
+            for(int j=first;j<last;j++){
+                lookSym[j] = i;
+                lookLen[j] = len[i];
+            }
+        }
+    }
+}
+
+/*
+ * Add code to the block being written, writing the block once it is full
+ */
+void HuffPut(int code){
+    block[nBlock++] = code;
+    if(nBlock == HUFF_BLOCK){
+        writeBlock();
+    }
+}
+
+/*
+ * Write the last block and the empty block ending the stream
+ */
+void HuffFlush(void){
+    if(nBlock != 0){
+        writeBlock();
+    }
+    writeBits(COUNT_BITS,0);
+    padBytes();
+}
+
+/*
+ * Write the codes given so far and pad to a whole byte, so that decode
+ * can read all of them before anything else is written
+ */
+void HuffSync(void){
+    if(nBlock != 0){
+        writeBlock();
+    }
+    padBytes();
+}
+
+/*
+ * Return the next code from standard input or EOF at the end of the stream
+ */
+int HuffGet(void){
+    int c;
+    int s;//symbol read
+    int nExtra;//number of extra bits after the symbol
+    int want;//number of bits looked at
+
+    if(remaining == 0 && !done){
+        readBlock();
+    }
+    if(done){
+        return EOF;
+    }
+    //look at the next HUFF_MAX_LEN bits, padding with zeros past the end
+    //of the block as what follows may not have been written yet
+    want = (blockLeft < HUFF_MAX_LEN) ? (int) blockLeft : HUFF_MAX_LEN;
+    while(nIn < want){
+        if((c = getchar_unlocked()) == EOF){
+            break;
+        }
+        inBits = (inBits << 8) | c;
+        nIn += 8;
+        bytesIn++;
+    }
+    if(nIn >= HUFF_MAX_LEN){
+        s = (inBits >> (nIn - HUFF_MAX_LEN)) & ((1 << HUFF_MAX_LEN) - 1);
+    } else{
+        s = (inBits << (HUFF_MAX_LEN - nIn)) & ((1 << HUFF_MAX_LEN) - 1);
+    }
+    if(lookLen[s] == 0 || lookLen[s] > nIn || lookLen[s] > blockLeft){
+        fprintf(stderr, "LZW: Huffman Stream corrupt\n");
+        exit(1);
+    }
+    nIn -= lookLen[s];
+    blockLeft -= lookLen[s];
+    s = lookSym[s];
+    remaining--;
+    if(s < 256){
+        return s;
+    }
+    nExtra = ((s - 256) >> 4) + 4;
+    if(nExtra > blockLeft){
+        fprintf(stderr, "LZW: Huffman Stream corrupt\n");
+        exit(1);
+    }
+    blockLeft -= nExtra;
+    while(nIn < nExtra){
+        if((c = getchar_unlocked()) == EOF){
+            fprintf(stderr, "LZW: Huffman Stream corrupt\n");
+            exit(1);
+        }
+        inBits = (inBits << 8) | c;
+        nIn += 8;
+        bytesIn++;
+    }
+    nIn -= nExtra;
+    return ((16 + (s & 15)) << nExtra)
+            | (int) ((inBits >> nIn) & ((1UL << nExtra) - 1));
+}
+
+/*
+ * Skip the padding written by HuffSync
+ */
+void HuffAlign(void){
+    nIn -= nIn % 8;
+}
+
+/*
+ * Forget the stream written or read so far, to start another
+ */
+void HuffReset(void){
+    nBlock = 0;
+    outBits = 0;
+    nOut = 0;
+    nOutBytes = 0;
+    inBits = 0;
+    nIn = 0;
+    remaining = 0;
+    blockLeft = 0;
+    done = 0;
+    bytesOut = 0;
+    bytesIn = 0;
+}
+
+/*
+ * Return the number of bytes written to standard output so far
+ */
+long HuffWritten(void){
+    return bytesOut;
+}
+
+/*
+ * Return the number of bytes of standard input used so far
+ */
+long HuffRead(void){
+    return bytesIn - nIn / 8;
+}
@@ -0,0 +1,19 @@
+/*
+ * Block Huffman coding of the codes written by encode
+ */
+
+void HuffPut(int code);
+
+void HuffFlush(void);
+
+void HuffSync(void);
+
+void HuffAlign(void);
+
+int HuffGet(void);
+
+void HuffReset(void);
+
+long HuffWritten(void);
+
+long HuffRead(void);
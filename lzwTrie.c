@@ -0,0 +1,122 @@
+/*
+ * Trie compiled from a frozen dictionary (the table is full and is never
+ * pruned), so that encode can follow a byte from a code with an array
+ * lookup instead of hashing.
+ * Codes with many children get a dense array with a child for every
+ * symbol; the rest keep their children in a compact array sorted by symbol.
+ */
+#include <stdlib.h>
+#include <assert.h>
+#include "./lzwTrie.h"
+
+#define TRIE_DENSE (16)//fraction of the symbols a code needs as children
+                       //to get a dense array (16 of 256 bytes)
+#define TRIE_LITERAL (2)//code of the first literal (0 and 1 are reserved)
+
+struct trie{
+    int n;//number of codes
+    int symbols;//number of symbols a code can be followed by
+    int *first;//index in keys/kids of the first child of each code
+    unsigned short *keys;//symbols of the children, sorted for each code
+    int *kids;//codes of the children
+    int **dense;//dense child arrays of codes with many children
+};
+
+/*
+ * Build the trie of the n codes where code i is code prefix[i]
+ * followed by symbol c[i] (prefix -1 for the literals), with symbols
+ * possible symbols (at most 65536)
+ */
+Trie TrieCreate(int n, int *prefix, int *c, int symbols){
+    Trie tr = malloc(sizeof(struct trie));
+    int *count;//children of each code placed so far
+    int at;//position of a child in keys/kids
+
+    assert(tr != 0);
+    tr->n = n;
+    tr->symbols = symbols;
+    tr->first = calloc(n + 1,sizeof(int));
+    tr->dense = calloc(n,sizeof(int *));
+    count = calloc(n,sizeof(int));
+    assert(tr->first != 0 && tr->dense != 0 && count != 0);
+
+    //count children of each code, then turn counts into offsets
+    for(int i=TRIE_LITERAL;i<n;i++){
+        if(prefix[i] >= 0){
+            tr->first[prefix[i] + 1]++;
+        }
+    }
+    for(int i=0;i<n;i++){
+        tr->first[i + 1] += tr->first[i];
+    }
+    tr->keys = malloc(sizeof(unsigned short) * (tr->first[n] + 1));
+    tr->kids = malloc(sizeof(int) * (tr->first[n] + 1));
+    assert(tr->keys != 0 && tr->kids != 0);
+
+    //insertion sort each child into place among its siblings
+    for(int i=TRIE_LITERAL;i<n;i++){
+        if(prefix[i] < 0){
+            continue;
+        }
+        at = tr->first[prefix[i]] + count[prefix[i]]++;
+        while(at > tr->first[prefix[i]] && tr->keys[at - 1] > c[i]){
+            tr->keys[at] = tr->keys[at - 1];
+            tr->kids[at] = tr->kids[at - 1];
+            at--;
+        }
+        tr->keys[at] = c[i];
+        tr->kids[at] = i;
+    }
+    free(count);
+
+    //give the busiest codes dense arrays
+    for(int i=0;i<n;i++){
+        if((tr->first[i + 1] - tr->first[i]) * TRIE_DENSE >= symbols){
+            tr->dense[i] = malloc(sizeof(int) * symbols);
+            assert(tr->dense[i] != 0);
+            for(int k=0;k<symbols;k++){
+                tr->dense[i][k] = -1;
+            }
+            for(int j=tr->first[i];j<tr->first[i + 1];j++){
+                tr->dense[i][tr->keys[j]] = tr->kids[j];
+            }
+        }
+    }
+    return tr;
+}
+
+/*
+ * Returns the code of prefix followed by c, or -1 if there is none
+ * (prefix -1 gives the literal of c)
+ */
+int TrieGet(Trie tr, int prefix, int c){
+    if(prefix < 0){
+        return TRIE_LITERAL + c;
+    }
+    if(tr->dense[prefix] != 0){
+        return tr->dense[prefix][c];
+    }
+    for(int j=tr->first[prefix];j<tr->first[prefix + 1];j++){
+        if(tr->keys[j] >= c){
+            return (tr->keys[j] == c) ? tr->kids[j] : -1;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Free memory in trie
+ */
+void TrieDestroy(Trie tr){
+    if(tr == 0){
+        return;
+    }
+    for(int i=0;i<tr->n;i++){
+        free(tr->dense[i]);
+    }
+    free(tr->dense);
+    free(tr->first);
+    free(tr->keys);
+    free(tr->kids);
+    free(tr);
+}
@@ -0,0 +1,11 @@
+/*
+ * Read-only trie over a dictionary that no longer changes
+ */
+
+typedef struct trie *Trie;
+
+Trie TrieCreate(int n, int *prefix, int *c, int symbols);
+
+int TrieGet(Trie tr, int prefix, int c);
+
+void TrieDestroy(Trie tr);